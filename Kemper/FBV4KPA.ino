@@ -21,13 +21,24 @@
 *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 //=========================================================================
+// the FBV gestures are not used, leaving them out saves 129 bytes of SRAM on the Mega
+#define LINE6FBV_FEATURES (LINE6FBV_FEATURES_ALL & ~LINE6FBV_FEATURE_GESTURES)
 #include "Line6Fbv.h"
+#include "Line6FbvPedalFilter.h"
 #include "KPA_defines.h"
 #include <MIDI.h>
 //using namespace midi;
 //============= Serial Ports of the Arduino Mega ==========================
 #define SERIAL_FBV Serial1
 #define SERIAL_KPA Serial3
+#ifndef SERIAL_TX_BUFFER_SIZE
+#define SERIAL_TX_BUFFER_SIZE 64   // TX ring of HardwareSerial in the AVR core
+#endif
+// a controller change is written only while at most one message waits in the TX ring,
+// so the newest value isn't queued behind a row of stale ones
+#define KPA_TX_IDLE_SPACE (SERIAL_TX_BUFFER_SIZE - 1 - 3)
+// uncomment to decode FBV frames in the RX interrupt of USART 1 instead of SERIAL_FBV
+//#define FBV_RX_INTERRUPT
 //=========================================================================
 #define FLASH_TIME 1000
 #define HOLD_TIME_SWITCH_LOOPER 1000
@@ -47,6 +58,9 @@
 #define SWTCH_PRF_SLOT_3    LINE6FBV_CHANNELA
 #define SWTCH_PRF_SLOT_4    LINE6FBV_CHANNELB 
 #define SWTCH_PRF_SLOT_5    LINE6FBV_CHANNELC
+#define LEDS_PRF_SLOTS (LINE6FBV_LED(SWTCH_PRF_SLOT_1) | LINE6FBV_LED(SWTCH_PRF_SLOT_2) \
+	| LINE6FBV_LED(SWTCH_PRF_SLOT_3) | LINE6FBV_LED(SWTCH_PRF_SLOT_4) | LINE6FBV_LED(SWTCH_PRF_SLOT_5))
+const byte prfSlotSwitches[5] = { SWTCH_PRF_SLOT_1, SWTCH_PRF_SLOT_2, SWTCH_PRF_SLOT_3, SWTCH_PRF_SLOT_4, SWTCH_PRF_SLOT_5 };
 
 #define SWTCH_FX_SLOT_A     LINE6FBV_FXLOOP
 #define SWTCH_FX_SLOT_B     LINE6FBV_STOMP1
@@ -81,12 +95,23 @@
 
 #define NAME_LENGTH 32 // Perfomance, Performance Slot and Rig name
 
+// display overlays on the FBV, a higher layer covers the lower ones
+#define DISPLAY_LAYER_PREVIEW  0   // performance number while browsing
+#define DISPLAY_LAYER_TUNER    1
+#define DISPLAY_LAYER_STATUS   2   // connection messages
+#define STATUS_MESSAGE_TIME    1500
+
 #define CC_BANK_MSB  0x00 
 #define CC_BANK_LSB  0x20
 
 
 MIDI_CREATE_INSTANCE(HardwareSerial, SERIAL_KPA, kpa);
-Line6Fbv fbv = Line6Fbv();
+#ifdef FBV_RX_INTERRUPT
+Line6Fbv<Line6FbvUsart<1> > fbv;
+LINE6FBV_USART_ISR(1)
+#else
+Line6Fbv<> fbv = Line6Fbv<>();
+#endif
 
 struct SysEx {                          // sysex message container
 	char header[5];
@@ -95,6 +120,18 @@ struct SysEx {                          // sysex message container
 	unsigned char data[64];
 } sysexBuffer = { { 0x00, 0x20, 0x33, 0x02, 0x7f }, 0, 0, { 0 } };
 
+// pedal CCs wait here while the KPA port is busy, one slot per controller
+// a newer value overwrites the pending one, so the KPA gets the current
+// position after a burst of other messages, not a stale sweep
+#define CTL_SLOTS 4
+struct CtlSlot {
+	byte ctlNum;
+	byte ctlVal;
+	bool pending;
+};
+CtlSlot ctlSlots[CTL_SLOTS];
+byte ctlNextSlot = 0;   // round robin, a busy pedal can't starve the other one
+
 #define CNN_STATE_WAIT_SENSE         0
 #define CNN_STATE_CONNECT            1 
 #define CNN_STATE_WAIT_INITIAL_DATA  2
@@ -147,6 +184,8 @@ struct KpaState {
 	char rigName[NAME_LENGTH + 1];
 	bool looperIsOn;
 	uint32_t lastSent;
+	bool tapIsOn;          // the TAP LED flashes with the beat
+	uint32_t lastTap;      // last tap event from the KPA
 };
 
 	unsigned long nextLooperStateRequest = 0;
@@ -165,6 +204,8 @@ struct KpaState kpaState = {
 	{ { 0x00 } },
 	{ 0x00 },
 	false,
+	0,
+	false,
 	0
 };
 
@@ -177,6 +218,30 @@ struct FbvPedal{
 	byte cmpPos;
 	byte ledNumGrn;
 	byte ledNumRed;
+	byte curve;                  // PDL_CURVE_xxx
+	Line6FbvPedalFilter filter;  // dead-band, hysteresis and rate of the CCs sent
+};
+
+// response curves of the pedals, 128 bytes each in flash, generated by the compiler
+// selected per rig with the chars 29 and 30 of the rig name after a '#' (see getPdlCurve())
+#define PDL_CURVE_MARKER '#'
+enum {
+	PDL_CURVE_LINEAR,
+	PDL_CURVE_LOG,       // 'L' volume taper
+	PDL_CURVE_EXP,       // 'E'
+	PDL_CURVE_S,         // 'S'
+	PDL_CURVE_RANGE,     // 'R' wah without the extreme heel and toe positions
+	PDL_CURVE_SWELL,     // 'C' nothing in the first eighth, then fast up to 110
+	NUM_PDL_CURVES
+};
+
+const uint8_t* const pdlCurves[NUM_PDL_CURVES] = {
+	Line6FbvCurve<Line6FbvCurveLinear<> >::data,
+	Line6FbvCurve<Line6FbvCurveLog<> >::data,
+	Line6FbvCurve<Line6FbvCurveExp<> >::data,
+	Line6FbvCurve<Line6FbvCurveS<> >::data,
+	Line6FbvCurve<Line6FbvCurveLinear<16, 112> >::data,
+	Line6FbvCurve<Line6FbvCurvePoints<0, 0, 16, 0, 96, 110, 127, 127> >::data
 };
 
 
@@ -195,6 +260,7 @@ void initFbvPdlValues(){
 	fbvPdls[0].actPos = 0;
 	fbvPdls[0].cmpPos = 0;
 	fbvPdls[0].onOff = 0;
+	fbvPdls[0].curve = PDL_CURVE_LINEAR;
 	//     fbvPdls[0].ctlNumOff = KPA_CC_WAH;  // maybe used later to assign 2 Values to each pedal
 	//     fbvPdls[0].ctlNumOn = KPA_CC_GAIN;
 	fbvPdls[0].ctlNum = KPA_CC_WAH;
@@ -205,6 +271,7 @@ void initFbvPdlValues(){
 	fbvPdls[1].actPos = 127;
 	fbvPdls[1].cmpPos = 0;
 	fbvPdls[1].onOff = 0;
+	fbvPdls[1].curve = PDL_CURVE_LINEAR;
 	//     fbvPdls[1].ctlNumOff = KPA_CC_VOL;
 	//     fbvPdls[1].ctlNumOn = KPA_CC_MORPH;
 	fbvPdls[1].ctlNum = KPA_CC_VOL;
@@ -312,7 +379,7 @@ void onKpaCtlChange(byte chan, byte inCtlNum, byte inCtlVal){
 	{
 	case KPA_CC_PERFORMANCE_NUM_PREVIEW:
 		if (inCtlVal != 0x7f){
-			fbv.setDisplayNumber(inCtlVal + 1);
+			fbv.setOverlayNumber(DISPLAY_LAYER_PREVIEW, inCtlVal + 1);
 			kpaState.preview = true;
 			fbv.setDisplayFlash((FLASH_TIME / 2), (FLASH_TIME / 4));
 		}
@@ -339,8 +406,6 @@ void onKpaPgmChange(byte chan, byte inMidiPgmNum)
 {
 
 	uint16_t pgmNum;
-	byte channels[5] = { 0, 0, 0, 0, 0 };
-
 
 	pgmNum = (kpaState.bankNum * 128) + inMidiPgmNum;
 	if (pgmNum != kpaState.pgmNum){
@@ -350,13 +415,9 @@ void onKpaPgmChange(byte chan, byte inMidiPgmNum)
 
 		kpaState.actSlot = kpaState.pgmNum % 5;
 		kpaState.actPerformance = kpaState.pgmNum / 5;
-		channels[kpaState.actSlot] = 1;
-		fbv.setLedOnOff(SWTCH_PRF_SLOT_1, channels[0]);
-		fbv.setLedOnOff(SWTCH_PRF_SLOT_2, channels[1]);
-		fbv.setLedOnOff(SWTCH_PRF_SLOT_3, channels[2]);
-		fbv.setLedOnOff(SWTCH_PRF_SLOT_4, channels[3]);
-		fbv.setLedOnOff(SWTCH_PRF_SLOT_5, channels[4]);
+		fbv.setLeds(LEDS_PRF_SLOTS, LINE6FBV_LED(prfSlotSwitches[kpaState.actSlot]));
 		fbv.setDisplayFlash(0, 1);
+		fbv.clearDisplayOverlay(DISPLAY_LAYER_PREVIEW);
 		fbv.setLedOnOff(LINE6FBV_DISPLAY, 1);
 		fbv.setDisplayNumber(kpaState.actPerformance + 1);
 
@@ -431,12 +492,8 @@ void processKpaModeChanged(uint16_t newMode){
 void refreshDisplay(void){
 	
 	//Serial.println("refreshDisplay");
-	if (kpaState.tunerIsOn){
-		fbv.setDisplayDigit(0, ' ');
-		fbv.setDisplayDigit(1, ' ');
-		fbv.setDisplayDigit(2, ' ');
-	}
-	else if (kpaState.mode == KPA_MODE_BROWSE)
+	// the tuner is an overlay, the display below always shows the mode
+	if (kpaState.mode == KPA_MODE_BROWSE)
 	{
 		fbv.setDisplayDigits("   ");
 		fbv.setDisplayFlat(false);
@@ -536,9 +593,10 @@ void displayTuner(){
 	else                        tuneString = "I ) ) )        I";
 
 
-	fbv.setDisplayDigit(3, noteName);
-	fbv.setDisplayFlat(flat);
-	fbv.setDisplayTitle(tuneString);
+	char digits[] = { ' ', ' ', ' ', noteName };
+	fbv.setOverlayDigits(DISPLAY_LAYER_TUNER, digits);
+	fbv.setOverlayFlat(DISPLAY_LAYER_TUNER, flat);
+	fbv.setOverlayTitle(DISPLAY_LAYER_TUNER, tuneString);
 	/*
 	#if DEBUG_displayTuner
 	Serial.print("Tuner Note_: ");
@@ -572,10 +630,20 @@ void processKpaParamSingle(uint16_t param, uint16_t value){
 			displayTuner();
 		break;
 	case KPA_PARAM_TAP_EVENT:
-		fbv.setLedOnOff(LINE6FBV_TAP, value);
+		// the KPA sends the beat, the TAP LED flashes from the beat clock of the FBV library
+		// so a late loop() doesn't shift it
+		if (value){
+			fbv.tapBeat();
+			if (!kpaState.tapIsOn)
+				fbv.setLedBeat(LINE6FBV_TAP);
+			kpaState.tapIsOn = true;
+			kpaState.lastTap = millis();
+		}
 		break;
 	case KPA_PARAM_TUNER_STATE:
 		kpaState.tunerIsOn = (value == 1);
+		if (!kpaState.tunerIsOn)
+			fbv.clearDisplayOverlay(DISPLAY_LAYER_TUNER);  // back to the rig
 		break;
 	case KPA_PARAM_MODE:
 		if (value != kpaState.mode)
@@ -680,16 +748,71 @@ void setLedForFxSlot(byte slotNum){
 
 void parseRigNameForPdlAssignment(void){
 	// the last two chars in the rig name are missused for pedal assignment
+	// and the two before them for the curves if a '#' precedes them, e.g. "...#LEWV",
+	// so rig names without the marker keep the linear curves
 	fbvPdls[0].ctlNum = getPdlCtlNum(kpaState.rigName[30], KPA_CC_WAH);
 	fbvPdls[1].ctlNum = getPdlCtlNum(kpaState.rigName[31], KPA_CC_VOL);
+	fbvPdls[0].curve = PDL_CURVE_LINEAR;
+	fbvPdls[1].curve = PDL_CURVE_LINEAR;
+	if (kpaState.rigName[27] == PDL_CURVE_MARKER){
+		fbvPdls[0].curve = getPdlCurve(kpaState.rigName[28], PDL_CURVE_LINEAR);
+		fbvPdls[1].curve = getPdlCurve(kpaState.rigName[29], PDL_CURVE_LINEAR);
+	}
 	setFbvPdlLeds(0);
 	setFbvPdlLeds(1);
 
+	// the new controllers get the actual pedal positions right away
+	sendFbvPdlPos(0);
+	sendFbvPdlPos(1);
+
 	// if neither padal is the volume pedal, send Volume = 127
 	if (fbvPdls[0].ctlNum != KPA_CC_VOL && fbvPdls[1].ctlNum != KPA_CC_VOL)
 		kpaSendCtlChange(KPA_CC_VOL, 127);
 }
 
+// send the position of the pedal cached by the library, if the FBV reported it already
+void sendFbvPdlPos(byte _pdlNum){
+	byte pos = fbv.getPedalPos(_pdlNum == 0 ? LINE6FBV_CC_PDL1 : LINE6FBV_CC_PDL2);
+	if (pos == LINE6FBV_PEDAL_UNKNOWN)
+		return;
+	fbvPdls[_pdlNum].actPos = pos;
+	fbvPdls[_pdlNum].filter.reset(pos);
+	if (fbvPdls[_pdlNum].ctlNum)
+		kpaSendCtlChange(fbvPdls[_pdlNum].ctlNum, getPdlCurveValue(_pdlNum, pos));
+}
+
+// the position of a pedal through its curve
+byte getPdlCurveValue(byte _pdlNum, byte pos){
+	return pgm_read_byte(&pdlCurves[fbvPdls[_pdlNum].curve][pos & 0x7F]);
+}
+
+uint8_t getPdlCurve(char curveChar, uint8_t defVal){
+
+	uint8_t retval;
+
+	switch (curveChar){
+	case 'L':
+		retval = PDL_CURVE_LOG;
+		break;
+	case 'E':
+		retval = PDL_CURVE_EXP;
+		break;
+	case 'S':
+		retval = PDL_CURVE_S;
+		break;
+	case 'R':
+		retval = PDL_CURVE_RANGE;
+		break;
+	case 'C':
+		retval = PDL_CURVE_SWELL;
+		break;
+	default:
+		retval = defVal;
+		break;
+	}
+	return retval;
+}
+
 uint8_t getPdlCtlNum(char pdlChar, uint8_t defVal){
 
 	//Serial.print("Pdl Char: ");
@@ -885,9 +1008,50 @@ void sendBiConn(void){
 }
 
 void kpaSendCtlChange(byte inCtlNum, byte inCtlVal){
+	// this value is newer than a pending one of the same controller
+	for (byte i = 0; i < CTL_SLOTS; i++){
+		if (ctlSlots[i].pending && ctlSlots[i].ctlNum == inCtlNum)
+			ctlSlots[i].pending = false;
+	}
 	kpa.sendControlChange(inCtlNum, inCtlVal, KPA_MIDI_CHANNEL);
 }
 
+// send a continuous controller (pedal) without blocking, the last value wins
+void kpaQueueCtlChange(byte inCtlNum, byte inCtlVal){
+	CtlSlot* slot = 0;
+	for (byte i = 0; i < CTL_SLOTS; i++){
+		if (ctlSlots[i].ctlNum == inCtlNum){
+			slot = &ctlSlots[i];
+			break;
+		}
+		if (!ctlSlots[i].pending && !slot)
+			slot = &ctlSlots[i];
+	}
+	if (!slot){
+		kpaSendCtlChange(inCtlNum, inCtlVal);   // all slots busy with other controllers
+		return;
+	}
+	slot->ctlNum = inCtlNum;
+	slot->ctlVal = inCtlVal;
+	slot->pending = true;
+	kpaDrainCtlChanges();
+}
+
+// send the pending controllers while the KPA port is idle, called by loop()
+void kpaDrainCtlChanges(){
+	byte start = ctlNextSlot;
+	for (byte n = 0; n < CTL_SLOTS; n++){
+		byte i = (start + n) % CTL_SLOTS;
+		if (!ctlSlots[i].pending)
+			continue;
+		if (SERIAL_KPA.availableForWrite() < KPA_TX_IDLE_SPACE)   // status, controller, value
+			return;
+		ctlSlots[i].pending = false;
+		kpa.sendControlChange(ctlSlots[i].ctlNum, ctlSlots[i].ctlVal, KPA_MIDI_CHANNEL);
+		ctlNextSlot = (i + 1) % CTL_SLOTS;
+	}
+}
+
 
 // respond to pressed keys on the FBV
 void onFbvKeyPressed(byte inKey) {
@@ -1073,7 +1237,7 @@ void handleConnectionAndSomeRequests(){
 		}
 	case CNN_STATE_CONNECT:
 		if (millis() - kpaState.lastSent > 1000) {
-			fbv.setDisplayTitle("CONNECTING");
+			fbv.setOverlayTitle(DISPLAY_LAYER_STATUS, "CONNECTING", STATUS_MESSAGE_TIME);
 			sendOwner();
 			sendBiConn();
 			
@@ -1084,7 +1248,7 @@ void handleConnectionAndSomeRequests(){
 		break;
 	case CNN_STATE_WAIT_INITIAL_DATA:
 		if (millis() - kpaState.lastSent > 1000) {
-			fbv.setDisplayTitle("INITIAL REQUEST");
+			fbv.setOverlayTitle(DISPLAY_LAYER_STATUS, "INITIAL REQUEST", STATUS_MESSAGE_TIME);
 			
 			sendBiConn();
 			connection.state = CNN_STATE_RUN;
@@ -1142,16 +1306,22 @@ void onFbvCtlChange(byte inCtrl, byte inValue) {
 
 	if (inCtrl == LINE6FBV_CC_PDL1){
 		fbvPdls[0].actPos = inValue;
-		if (fbvPdls[0].ctlNum)
-			kpaSendCtlChange(fbvPdls[0].ctlNum, fbvPdls[0].actPos);
+		if (fbvPdls[0].filter.filter(inValue))
+			sendFbvPdlCtlChange(0);
 	}
 	else{
 		fbvPdls[1].actPos = inValue;
-		if (fbvPdls[1].ctlNum)
-			kpaSendCtlChange(fbvPdls[1].ctlNum, fbvPdls[1].actPos);
+		if (fbvPdls[1].filter.filter(inValue))
+			sendFbvPdlCtlChange(1);
 	}
 }
 
+// send the filtered position of a pedal
+void sendFbvPdlCtlChange(byte _pdlNum){
+	if (fbvPdls[_pdlNum].ctlNum)
+		kpaQueueCtlChange(fbvPdls[_pdlNum].ctlNum, getPdlCurveValue(_pdlNum, fbvPdls[_pdlNum].filter.getValue()));
+}
+
 void setLooperDigit(uint16_t value){
 
 	switch (value)
@@ -1191,7 +1361,11 @@ void setup()
 	digitalWrite(13, HIGH);
 
 	// open port for FBV 
+#ifdef FBV_RX_INTERRUPT
+	fbv.begin();
+#else
 	fbv.begin(&SERIAL_FBV);
+#endif
 
 	// set callback functions for the FBV
 	fbv.setHandleKeyPressed(&onFbvKeyPressed);
@@ -1203,32 +1377,13 @@ void setup()
 	fbv.setHoldTime(SWTCH_LOOPER, HOLD_TIME_SWITCH_LOOPER);
 	fbv.setHoldTime(SWTCH_RESET, HOLD_TIME_RESET);
 
-	// turn off all LEDs
-	fbv.setLedOnOff(LINE6FBV_FXLOOP, 0);
-	fbv.setLedOnOff(LINE6FBV_STOMP1, 0);
-	fbv.setLedOnOff(LINE6FBV_STOMP2, 0);
-	fbv.setLedOnOff(LINE6FBV_STOMP3, 0);
-	fbv.setLedOnOff(LINE6FBV_AMP1, 0);
-	fbv.setLedOnOff(LINE6FBV_AMP2, 0);
-	fbv.setLedOnOff(LINE6FBV_REVERB, 0);
-	fbv.setLedOnOff(LINE6FBV_PITCH, 0);
-	fbv.setLedOnOff(LINE6FBV_MOD, 0);
-	fbv.setLedOnOff(LINE6FBV_DELAY, 0);
-	fbv.setLedOnOff(LINE6FBV_TAP, 0);
-	fbv.setLedOnOff(LINE6FBV_UP, 0);
-	fbv.setLedOnOff(LINE6FBV_DOWN, 0);
-	fbv.setLedOnOff(LINE6FBV_CHANNELA, 0);
-	fbv.setLedOnOff(LINE6FBV_CHANNELB, 0);
-	fbv.setLedOnOff(LINE6FBV_CHANNELC, 0);
-	fbv.setLedOnOff(LINE6FBV_CHANNELD, 0);
-	fbv.setLedOnOff(LINE6FBV_FAVORITE, 0);
-	fbv.setLedOnOff(LINE6FBV_PDL1_GRN, 0);
-	fbv.setLedOnOff(LINE6FBV_PDL1_RED, 0);
-	fbv.setLedOnOff(LINE6FBV_PDL2_GRN, 0);
-	fbv.setLedOnOff(LINE6FBV_PDL2_RED, 0);
+	// turn off all LEDs but the display light
+	fbv.setLeds(LINE6FBV_LEDS_ALL, LINE6FBV_LED(LINE6FBV_DISPLAY));
+
+	// rig and slot names longer than 16 characters scroll through the title
+	fbv.setDisplayMarquee(300);
 
 	// display initial screen
-	fbv.setLedOnOff(LINE6FBV_DISPLAY, 1);
 	fbv.setDisplayTitle("WRBI(AT)ORBI");
 	fbv.updateUI();
 
@@ -1260,6 +1415,19 @@ void loop()
 
 	kpa.read();  // Receive Information from KPA
 
+	// pedal positions the filter held back
+	for (byte i = 0; i < 2; i++){
+		if (fbvPdls[i].filter.update())
+			sendFbvPdlCtlChange(i);
+	}
+	kpaDrainCtlChanges();
+
+	// the KPA stopped sending the beat
+	if (kpaState.tapIsOn && millis() - kpaState.lastTap > LINE6FBV_MAX_TAP_TIME){
+		kpaState.tapIsOn = false;
+		fbv.setLedOnOff(LINE6FBV_TAP, 0);
+	}
+
 	handleConnectionAndSomeRequests();  // keep bidirectional connection alive
 
 	fbv.updateUI(); // update the FBV display and LEDs
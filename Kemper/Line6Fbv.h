@@ -24,9 +24,10 @@
 /*
 ====Data received from the FBV:
 
-a heartbeat is sent every 7 seconds
+a heartbeat is sent every 7 seconds, two frames
 F0 02 90 00
 F0 02 30 08
+the board doesn't report its model, the answer to F0 02 01 00 is not decoded
 
 Switches:
 F0 03 81 <key-code><pressed=01/released=00>
@@ -63,8 +64,54 @@ F0 02 20 <00=off/01=on>
 #define LINE6FBV_H
 
 #include <Arduino.h>
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#endif
+
+// the tables stay in flash on the AVR, other cores read them like any constant
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef pgm_read_byte
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#endif
 
 #define LINE6FBV_CONNECTION_LOST_TIME 8000
+// getPedalPos() before the board reported the pedal
+#define LINE6FBV_PEDAL_UNKNOWN 0xFF
+// active liveness probing: ms to wait for the answer to a probe
+#define LINE6FBV_PROBE_TIMEOUT 150
+// the probe interval grows up to this factor while the board answers,
+// a lost board is probed at this rate
+#define LINE6FBV_PROBE_BACKOFF 4
+// unanswered probes in a row that are a disconnect
+#define LINE6FBV_PROBE_MISSES 3
+// state of the probe, the timeout starts when the frame is written
+#define LINE6FBV_PROBE_QUEUED 1
+#define LINE6FBV_PROBE_SENT 2
+
+// subsystems compiled into Line6Fbv, a sketch that doesn't need all of them
+// defines a smaller set before #include "Line6Fbv.h", e.g.
+// #define LINE6FBV_FEATURES (LINE6FBV_FEATURES_ALL & ~LINE6FBV_FEATURE_GESTURES)
+// the members and timers of a feature left out are gone, its functions don't exist
+// the same set must be used in all files of a sketch that include Line6Fbv.h
+#define LINE6FBV_FEATURE_LED_FLASH      0x01  // setLedFlash(), setLedBeat(), the beat clock
+#define LINE6FBV_FEATURE_DISPLAY_FLASH  0x02  // setDisplayFlash()
+#define LINE6FBV_FEATURE_HOLD           0x04  // setHoldTime(), setHandleKeyHeld()
+#define LINE6FBV_FEATURE_GESTURES       0x08  // setHandleGesture() and the gestures, needs LINE6FBV_FEATURE_HOLD
+#define LINE6FBV_FEATURE_MARQUEE        0x10  // setDisplayMarquee()
+#define LINE6FBV_FEATURE_OVERLAYS       0x20  // setOverlayXxx(), clearDisplayOverlay()
+#define LINE6FBV_FEATURES_ALL           0x3F
+
+#ifndef LINE6FBV_FEATURES
+#define LINE6FBV_FEATURES  LINE6FBV_FEATURES_ALL
+#endif
+
+#define LINE6FBV_HAS(feature)  ((LINE6FBV_FEATURES & (feature)) != 0)
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_GESTURES) && !LINE6FBV_HAS(LINE6FBV_FEATURE_HOLD)
+#error "LINE6FBV_FEATURE_GESTURES needs LINE6FBV_FEATURE_HOLD"
+#endif
 
 enum{
 	LINE6FBV_KEY_NONE,
@@ -138,10 +185,648 @@ LINE6FBV_NUM_LED_AND_SWITCH
 
 #define LINE6FBV_FLASH_TIME  50
 
+// beat clock for tempo linked LEDs, 120 bpm until set
+#define LINE6FBV_BEAT_TIME  500
+// taps further apart only move the beat, they don't change the tempo
+#define LINE6FBV_MIN_TAP_TIME  200
+#define LINE6FBV_MAX_TAP_TIME  2500
+
+// titles longer than 16 characters can scroll (marquee), e.g. KPA rig names
+#define LINE6FBV_MAX_TITLE_LENGTH  32
+#define LINE6FBV_MARQUEE_PAUSE  1500         // ms at the start and the end of the title
+#define LINE6FBV_MARQUEE_BYTES_PER_SECOND  200
+
+// display overlays, a higher layer covers the lower ones and the display itself
+#define LINE6FBV_NUM_OVERLAYS  3
+
+// gestures, configured for up to LINE6FBV_NUM_GESTURE_KEYS keys
+#define LINE6FBV_NUM_GESTURE_KEYS  6
+#define LINE6FBV_HOLD_TIERS  3
+#define LINE6FBV_CHORD_TIME  80     // ms both keys of a chord must be pressed within
+
+// gesture state of a key
+#define LINE6FBV_GST_WAIT_CHORD  0x01  // pressed, press not reported until the chord time is over
+#define LINE6FBV_GST_CHORD       0x02  // pressed as part of a chord
+
+enum{
+	LINE6FBV_GESTURE_DOUBLE_TAP = 1,   // value: 2
+	LINE6FBV_GESTURE_HOLD,             // value: hold tier 1 - LINE6FBV_HOLD_TIERS
+	LINE6FBV_GESTURE_REPEAT,           // value: number of the repetition (1 - 255)
+	LINE6FBV_GESTURE_CHORD             // value: the second key of the chord
+};
+
+// decoded frames wait here until dispatchEvents(), must be a power of 2
+#define LINE6FBV_EVENT_QUEUE_SIZE  16
+
+// keeps the compiler from moving memory accesses across the index update of the event queue
+#define LINE6FBV_MEMORY_BARRIER()  __asm__ __volatile__("" ::: "memory")
+
+// longest time between two timer runs when nothing flashes or is held
+#define LINE6FBV_MAX_SLEEP  60000
+
+// all frames of one updateUI() call are collected and written at once
+// updateUI() only queues what the transport takes without blocking, at most LINE6FBV_TX_BUDGET
+// bytes (the TX ring of the AVR core takes 63), LEDs first, then the display,
+// the rest is sent by the next call
+// the buffer has room for the budget and the two requests sent on connect (4 bytes each)
+#define LINE6FBV_TX_BUDGET  64
+#define LINE6FBV_TX_BUFFER_SIZE  (LINE6FBV_TX_BUDGET + 8)
+
+// display segments, changes are sent per segment
+#define LINE6FBV_SEG_DIGITS  0x0F  // one bit per digit 0-3
+#define LINE6FBV_SEG_FLAT  0x10
+#define LINE6FBV_SEG_TITLE  0x20
+#define LINE6FBV_SEG_ALL  0x3F
+
+
+// key code for each key number, same order as the enum above
+constexpr uint8_t line6FbvKeyCodes[LINE6FBV_NUM_LED_AND_SWITCH] = {
+	LINE6FBV_CC_KEY_NONE,
+	LINE6FBV_CC_FXLOOP,
+	LINE6FBV_CC_STOMP1,
+	LINE6FBV_CC_STOMP2,
+	LINE6FBV_CC_STOMP3,
+	LINE6FBV_CC_AMP1,
+	LINE6FBV_CC_AMP2,
+	LINE6FBV_CC_REVERB,
+	LINE6FBV_CC_PITCH,
+	LINE6FBV_CC_MOD,
+	LINE6FBV_CC_DELAY,
+	LINE6FBV_CC_TAP,
+	LINE6FBV_CC_UP,
+	LINE6FBV_CC_DOWN,
+	LINE6FBV_CC_CHANNELA,
+	LINE6FBV_CC_CHANNELB,
+	LINE6FBV_CC_CHANNELC,
+	LINE6FBV_CC_CHANNELD,
+	LINE6FBV_CC_FAVORITE,
+	LINE6FBV_CC_PDL1_GRN,
+	LINE6FBV_CC_PDL1_RED,
+	LINE6FBV_CC_PDL2_GRN,
+	LINE6FBV_CC_PDL2_RED,
+	LINE6FBV_CC_DISPLAY,
+	LINE6FBV_CC_PDL1_SW,
+	LINE6FBV_CC_PDL2_SW
+};
+
+
+// keys without a switch and keys without a LED
+#define LINE6FBV_KEYS_LED_ONLY ((1UL << LINE6FBV_PDL1_GRN) | (1UL << LINE6FBV_PDL1_RED) \
+	| (1UL << LINE6FBV_PDL2_GRN) | (1UL << LINE6FBV_PDL2_RED) | (1UL << LINE6FBV_DISPLAY))
+#define LINE6FBV_KEYS_SWITCH_ONLY ((1UL << LINE6FBV_PDL1_SW) | (1UL << LINE6FBV_PDL2_SW))
+
+// LED masks for setLeds()
+#define LINE6FBV_LED(key)  (1UL << (key))
+#define LINE6FBV_LEDS_STOMPS  (LINE6FBV_LED(LINE6FBV_FXLOOP) | LINE6FBV_LED(LINE6FBV_STOMP1) \
+	| LINE6FBV_LED(LINE6FBV_STOMP2) | LINE6FBV_LED(LINE6FBV_STOMP3))
+#define LINE6FBV_LEDS_EFFECTS  (LINE6FBV_LED(LINE6FBV_AMP1) | LINE6FBV_LED(LINE6FBV_AMP2) \
+	| LINE6FBV_LED(LINE6FBV_REVERB) | LINE6FBV_LED(LINE6FBV_PITCH) | LINE6FBV_LED(LINE6FBV_MOD) \
+	| LINE6FBV_LED(LINE6FBV_DELAY) | LINE6FBV_LED(LINE6FBV_TAP))
+#define LINE6FBV_LEDS_CHANNELS  (LINE6FBV_LED(LINE6FBV_CHANNELA) | LINE6FBV_LED(LINE6FBV_CHANNELB) \
+	| LINE6FBV_LED(LINE6FBV_CHANNELC) | LINE6FBV_LED(LINE6FBV_CHANNELD))
+#define LINE6FBV_LEDS_BANK  (LINE6FBV_LED(LINE6FBV_UP) | LINE6FBV_LED(LINE6FBV_DOWN) | LINE6FBV_LED(LINE6FBV_FAVORITE))
+#define LINE6FBV_LEDS_PEDALS  (LINE6FBV_LED(LINE6FBV_PDL1_GRN) | LINE6FBV_LED(LINE6FBV_PDL1_RED) \
+	| LINE6FBV_LED(LINE6FBV_PDL2_GRN) | LINE6FBV_LED(LINE6FBV_PDL2_RED))
+#define LINE6FBV_LEDS_ALL  (LINE6FBV_LEDS_STOMPS | LINE6FBV_LEDS_EFFECTS | LINE6FBV_LEDS_CHANNELS \
+	| LINE6FBV_LEDS_BANK | LINE6FBV_LEDS_PEDALS | LINE6FBV_LED(LINE6FBV_DISPLAY))
+
+
+// Compile time tables
+// Line6FbvTable<Gen, Line6FbvMakeSeq<N>::Type>::data is an array of N bytes in
+// flash, filled with Gen::value(0) ... Gen::value(N - 1) by the compiler.
+
+template<uint8_t... Is>
+struct Line6FbvSeq {};
+
+template<unsigned N, uint8_t... Is>
+struct Line6FbvMakeSeq : Line6FbvMakeSeq<N - 1, N - 1, Is...> {};
+
+template<uint8_t... Is>
+struct Line6FbvMakeSeq<0, Is...> {
+	typedef Line6FbvSeq<Is...> Type;
+};
+
+template<class Gen, class Seq>
+struct Line6FbvTable;
+
+template<class Gen, uint8_t... Is>
+struct Line6FbvTable<Gen, Line6FbvSeq<Is...> > {
+	static const uint8_t data[sizeof...(Is)];
+};
+
+template<class Gen, uint8_t... Is>
+const uint8_t Line6FbvTable<Gen, Line6FbvSeq<Is...> >::data[sizeof...(Is)] PROGMEM = { Gen::value(Is)... };
+
+
+// Pedal response curves
+// Line6FbvCurve<Gen>::data maps the 128 pedal positions in flash,
+// applying a curve is one pgm_read_byte(&data[position]).
+// The curves map 0 - 127 to Min - Max, Max < Min turns the pedal around.
+// log and exp are parabolas, constexpr functions (C++11) can't call log() or exp().
+
+template<class Gen>
+struct Line6FbvCurve : Line6FbvTable<Gen, typename Line6FbvMakeSeq<128>::Type> {};
+
+template<uint8_t Min = 0, uint8_t Max = 127>
+struct Line6FbvCurveLinear {
+	static constexpr uint8_t value(uint8_t x){
+		return Min + ((long)Max - Min) * x / 127;
+	}
+};
+
+// steep at first, then flat: the taper of a volume pedal
+template<uint8_t Min = 0, uint8_t Max = 127>
+struct Line6FbvCurveLog {
+	static constexpr uint8_t value(uint8_t x){
+		return Min + ((long)Max - Min) * (127L * 127 - (127L - x) * (127 - x)) / (127L * 127);
+	}
+};
+
+// flat at first, then steep
+template<uint8_t Min = 0, uint8_t Max = 127>
+struct Line6FbvCurveExp {
+	static constexpr uint8_t value(uint8_t x){
+		return Min + ((long)Max - Min) * x * x / (127L * 127);
+	}
+};
+
+// flat at both ends, steep in the middle (smoothstep)
+template<uint8_t Min = 0, uint8_t Max = 127>
+struct Line6FbvCurveS {
+	static constexpr uint8_t value(uint8_t x){
+		return Min + ((long)Max - Min) * x * x * (3L * 127 - 2 * x) / (127L * 127 * 127);
+	}
+};
+
+// straight lines between breakpoints x0, y0, x1, y1, ... with rising x
+// before the first and after the last point the curve is flat
+template<uint8_t... Points>
+struct Line6FbvCurvePoints;
+
+template<uint8_t X0, uint8_t Y0>
+struct Line6FbvCurvePoints<X0, Y0> {
+	static constexpr uint8_t value(uint8_t){
+		return Y0;
+	}
+};
+
+template<uint8_t X0, uint8_t Y0, uint8_t X1, uint8_t Y1, uint8_t... Rest>
+struct Line6FbvCurvePoints<X0, Y0, X1, Y1, Rest...> {
+	static_assert(X0 < X1, "the x of the breakpoints must rise");
+
+	static constexpr uint8_t value(uint8_t x){
+		return x <= X0 ? Y0
+			: x < X1 ? Y0 + ((long)Y1 - Y0) * (x - X0) / (X1 - X0)
+			: Line6FbvCurvePoints<X1, Y1, Rest...>::value(x);
+	}
+};
+
+
+// Board profiles
+// A profile lists the keys (switches and LEDs) of one pedalboard model.
+// Line6Fbv only keeps state for these keys. The first key of each profile
+// must be LINE6FBV_KEY_NONE, it catches all codes not on the board.
+// The key code of an incoming frame is translated by a 256 byte table,
+// so there's no search on key events.
+
+template<uint8_t... Keys>
+struct Line6FbvProfile {
+
+	static constexpr uint8_t numKeys = sizeof...(Keys);
+	static constexpr uint8_t keys[numKeys] = { Keys... };
+
+	// bits (1UL << key) of the keys in inFilter, from inSlot on
+	static constexpr uint32_t keyMask(uint32_t inFilter, uint8_t inSlot = 1){
+		return inSlot >= numKeys ? 0
+			: ((1UL << keys[inSlot]) & inFilter) | keyMask(inFilter, inSlot + 1);
+	}
+
+	static constexpr uint32_t ledMask(){
+		return keyMask(~(uint32_t)LINE6FBV_KEYS_SWITCH_ONLY);
+	}
+
+	static constexpr uint32_t switchMask(){
+		return keyMask(~(uint32_t)LINE6FBV_KEYS_LED_ONLY);
+	}
+
+	// every key is in the slot of its number, e.g. the Longboard
+	static constexpr bool keysAreSlots(uint8_t inSlot = 0){
+		return inSlot >= numKeys ? true
+			: keys[inSlot] == inSlot && keysAreSlots(inSlot + 1);
+	}
+
+	// slots of the keys in inKeyMask (bit 1UL << key), without slot 0
+	static inline uint32_t slotsOfKeys(uint32_t inKeyMask){
+		enum { direct = keysAreSlots() };   // evaluated by the compiler
+		if (direct)
+			return inKeyMask & (((1UL << (numKeys - 1)) << 1) - 2);
+		uint32_t slots = 0;
+		for (uint8_t i = 1; i < numKeys; i++){
+			if (inKeyMask & (1UL << keyOfSlot(i)))
+				slots |= 1UL << i;
+		}
+		return slots;
+	}
+
+	static constexpr uint8_t numPedals(){
+		return keyMask(1UL << LINE6FBV_PDL2_SW) ? 2 : keyMask(1UL << LINE6FBV_PDL1_SW) ? 1 : 0;
+	}
+
+	// position of a key code in the profile, 0 if not found
+	struct CodeToSlot {
+		static constexpr uint8_t value(uint8_t inCode, uint8_t inSlot = 0){
+			return inSlot >= numKeys ? 0
+				: line6FbvKeyCodes[keys[inSlot]] == inCode ? inSlot
+				: value(inCode, inSlot + 1);
+		}
+	};
+
+	// position of a key number in the profile, 0 if not found
+	struct KeyToSlot {
+		static constexpr uint8_t value(uint8_t inKey, uint8_t inSlot = 0){
+			return inSlot >= numKeys ? 0
+				: keys[inSlot] == inKey ? inSlot
+				: value(inKey, inSlot + 1);
+		}
+	};
+
+	typedef Line6FbvTable<CodeToSlot, Line6FbvMakeSeq<256>::Type> CodeTable;
+	typedef Line6FbvTable<KeyToSlot, Line6FbvMakeSeq<LINE6FBV_NUM_LED_AND_SWITCH>::Type> KeyTable;
+
+	static const uint8_t slotKeys[numKeys];
+	static const uint8_t slotCodes[numKeys];
+
+	static inline uint8_t slotOfCode(byte inCode){
+		return pgm_read_byte(&CodeTable::data[inCode]);
+	}
+
+	static inline uint8_t slotOfKey(byte inKey){
+		if (inKey >= LINE6FBV_NUM_LED_AND_SWITCH)
+			return 0;
+		return pgm_read_byte(&KeyTable::data[inKey]);
+	}
+
+	static inline uint8_t keyOfSlot(uint8_t inSlot){
+		return pgm_read_byte(&slotKeys[inSlot]);
+	}
+
+	static inline uint8_t codeOfSlot(uint8_t inSlot){
+		return pgm_read_byte(&slotCodes[inSlot]);
+	}
+};
+
+template<uint8_t... Keys>
+constexpr uint8_t Line6FbvProfile<Keys...>::keys[];
+
+template<uint8_t... Keys>
+const uint8_t Line6FbvProfile<Keys...>::slotKeys[] PROGMEM = { Keys... };
+
+template<uint8_t... Keys>
+const uint8_t Line6FbvProfile<Keys...>::slotCodes[] PROGMEM = { line6FbvKeyCodes[Keys]... };
+
+// FBV Longboard (default)
+typedef Line6FbvProfile<
+	LINE6FBV_KEY_NONE,
+	LINE6FBV_FXLOOP, LINE6FBV_STOMP1, LINE6FBV_STOMP2, LINE6FBV_STOMP3,
+	LINE6FBV_AMP1, LINE6FBV_AMP2, LINE6FBV_REVERB, LINE6FBV_PITCH,
+	LINE6FBV_MOD, LINE6FBV_DELAY, LINE6FBV_TAP,
+	LINE6FBV_UP, LINE6FBV_DOWN,
+	LINE6FBV_CHANNELA, LINE6FBV_CHANNELB, LINE6FBV_CHANNELC, LINE6FBV_CHANNELD,
+	LINE6FBV_FAVORITE,
+	LINE6FBV_PDL1_GRN, LINE6FBV_PDL1_RED, LINE6FBV_PDL2_GRN, LINE6FBV_PDL2_RED,
+	LINE6FBV_DISPLAY,
+	LINE6FBV_PDL1_SW, LINE6FBV_PDL2_SW
+> Line6FbvLongboard;
+
+// FBV Shortboard: one pedal, no second stomp row
+typedef Line6FbvProfile<
+	LINE6FBV_KEY_NONE,
+	LINE6FBV_FXLOOP, LINE6FBV_STOMP1,
+	LINE6FBV_REVERB, LINE6FBV_MOD, LINE6FBV_DELAY, LINE6FBV_TAP,
+	LINE6FBV_UP, LINE6FBV_DOWN,
+	LINE6FBV_CHANNELA, LINE6FBV_CHANNELB, LINE6FBV_CHANNELC, LINE6FBV_CHANNELD,
+	LINE6FBV_PDL1_GRN, LINE6FBV_PDL1_RED,
+	LINE6FBV_DISPLAY,
+	LINE6FBV_PDL1_SW
+> Line6FbvShortboard;
+
+// FBV Express: channels A-D and one pedal, no display
+typedef Line6FbvProfile<
+	LINE6FBV_KEY_NONE,
+	LINE6FBV_CHANNELA, LINE6FBV_CHANNELB, LINE6FBV_CHANNELC, LINE6FBV_CHANNELD,
+	LINE6FBV_PDL1_GRN, LINE6FBV_PDL1_RED,
+	LINE6FBV_PDL1_SW
+> Line6FbvExpress;
+
+
+// what the board of the profile has, bits are (1UL << key)
+// the FBV doesn't report its model, the board comes only from the Profile
+struct Line6FbvBoardInfo{
+	uint32_t leds;
+	uint32_t switches;
+	byte pedals;
+};
+
+
+// one frame received from the FBV
+// F0 <length> <opcode> <data 0> [<data 1>]
+struct Line6FbvEvent{
+	byte length;
+	byte opcode;
+	byte data[2];
+	unsigned long arrival;   // micros() when the last byte of the frame was decoded
+};
+
+// frames from the FBV that are queued as events, with their length byte
+// frames with other opcodes are skipped by their length
+struct Line6FbvFrameType{
+	byte opcode;
+	byte length;
+};
+
+const Line6FbvFrameType line6FbvFrameTypes[] PROGMEM = {
+	{ 0x81, 0x03 },   // switch: key code, 00 released / 01 pressed
+	{ 0x82, 0x03 },   // pedal: pedal number, position
+	{ 0x90, 0x02 },   // heartbeat, first frame
+	{ 0x30, 0x02 }    // heartbeat, second frame
+};
+
+
+// Transport policies
+// The class Line6Fbv does not talk to the serial port directly, all bytes pass
+// a transport class given as template parameter. The calls are resolved at
+// compile time, so they can be inlined.
+// Line6FbvRingBuffer keeps the bytes in memory, e.g. to run the library on a PC.
+// Any other transport has to provide the same members.
+// setReceiver() is for transports that receive in an interrupt: they pass each
+// byte to the function right away, available() then always returns 0.
+
+typedef void Line6FbvReceiveFunc(void*, byte);
+
+// port of the transports that don't use a HardwareSerial
+struct Line6FbvNoPort {};
+
+// default: the hardware serial ports of the Arduino
+class Line6FbvHardwareSerial {
+public:
+	typedef HardwareSerial PortType;
+
+	inline void begin(HardwareSerial* inSerial){
+		mSerial = inSerial;
+		mSerial->begin(32150);
+	}
+
+	// bytes are read by Line6Fbv::decode()
+	inline void setReceiver(Line6FbvReceiveFunc*, void*){
+	}
+
+	inline int available(){
+		return mSerial->available();
+	}
+
+	inline byte read(){
+		return mSerial->read();
+	}
+
+	inline void write(byte inByte){
+		mSerial->write(inByte);
+	}
+
+	inline void write(const byte* inBuffer, size_t inLength){
+		mSerial->write(inBuffer, inLength);
+	}
+
+	// bytes that can be written without blocking
+	inline int availableForWrite(){
+		return mSerial->availableForWrite();
+	}
+
+private:
+	HardwareSerial * mSerial;
+};
+
+
+// in memory: the bytes of the board are put in with putRx(), the frames for the board
+// are taken with takeTx(), e.g. to run the library on a PC or to test a sketch without a board
+// must be a power of 2
+#define LINE6FBV_RING_BUFFER_SIZE  128
+
+class Line6FbvRingBuffer {
+public:
+	typedef Line6FbvNoPort PortType;
+
+	inline void begin(Line6FbvNoPort*){
+		mRxHead = mRxTail = 0;
+		mTxHead = mTxTail = 0;
+	}
+
+	// bytes are read by Line6Fbv::decode()
+	inline void setReceiver(Line6FbvReceiveFunc*, void*){
+	}
+
+	inline int available(){
+		return (mRxHead - mRxTail) & (LINE6FBV_RING_BUFFER_SIZE - 1);
+	}
+
+	inline byte read(){
+		byte inByte = mRxBuffer[mRxTail];
+		mRxTail = (mRxTail + 1) & (LINE6FBV_RING_BUFFER_SIZE - 1);
+		return inByte;
+	}
+
+	// full: the byte is dropped, updateUI() checks availableForWrite() so this doesn't happen
+	inline void write(byte inByte){
+		uint8_t next = (mTxHead + 1) & (LINE6FBV_RING_BUFFER_SIZE - 1);
+		if (next == mTxTail)
+			return;
+		mTxBuffer[mTxHead] = inByte;
+		mTxHead = next;
+	}
+
+	inline void write(const byte* inBuffer, size_t inLength){
+		while (inLength--)
+			write(*inBuffer++);
+	}
+
+	inline int availableForWrite(){
+		return (mTxTail - mTxHead - 1) & (LINE6FBV_RING_BUFFER_SIZE - 1);
+	}
+
+	// the side of the board: false if the byte doesn't fit
+	inline bool putRx(byte inByte){
+		uint8_t next = (mRxHead + 1) & (LINE6FBV_RING_BUFFER_SIZE - 1);
+		if (next == mRxTail)
+			return false;
+		mRxBuffer[mRxHead] = inByte;
+		mRxHead = next;
+		return true;
+	}
 
+	inline int availableTx(){
+		return (mTxHead - mTxTail) & (LINE6FBV_RING_BUFFER_SIZE - 1);
+	}
+
+	inline byte takeTx(){
+		byte outByte = mTxBuffer[mTxTail];
+		mTxTail = (mTxTail + 1) & (LINE6FBV_RING_BUFFER_SIZE - 1);
+		return outByte;
+	}
+
+private:
+	byte mRxBuffer[LINE6FBV_RING_BUFFER_SIZE];
+	byte mTxBuffer[LINE6FBV_RING_BUFFER_SIZE];
+	uint8_t mRxHead;
+	uint8_t mRxTail;
+	uint8_t mTxHead;
+	uint8_t mTxTail;
+};
+
+
+#if defined(__AVR__)
+
+// interrupt driven: USART n of the AVR without HardwareSerial
+// frames are decoded in the RX interrupt as the bytes arrive, each one stamped with micros()
+// Serial<n> must not be used anywhere in the sketch, its interrupts would clash.
+// The sketch has to add the interrupt handlers once:
+//
+//   Line6Fbv<Line6FbvUsart<1> > fbv;
+//   LINE6FBV_USART_ISR(1)
+//   ...
+//   fbv.begin();
+
+template<uint8_t N>
+struct Line6FbvUsartRegs;
+
+#define LINE6FBV_USART_REGS(n) \
+	template<> struct Line6FbvUsartRegs<n> { \
+		static inline volatile uint8_t& ucsra(){ return UCSR##n##A; } \
+		static inline volatile uint8_t& ucsrb(){ return UCSR##n##B; } \
+		static inline volatile uint8_t& ucsrc(){ return UCSR##n##C; } \
+		static inline volatile uint8_t& ubrrh(){ return UBRR##n##H; } \
+		static inline volatile uint8_t& ubrrl(){ return UBRR##n##L; } \
+		static inline volatile uint8_t& udr(){ return UDR##n; } \
+	};
+
+#if defined(UCSR0A)
+LINE6FBV_USART_REGS(0)
+#endif
+#if defined(UCSR1A)
+LINE6FBV_USART_REGS(1)
+#endif
+#if defined(UCSR2A)
+LINE6FBV_USART_REGS(2)
+#endif
+#if defined(UCSR3A)
+LINE6FBV_USART_REGS(3)
+#endif
+
+#define LINE6FBV_USART_ISR(n) \
+	ISR(USART##n##_RX_vect){ Line6FbvUsart<n>::rxInterrupt(); } \
+	ISR(USART##n##_UDRE_vect){ Line6FbvUsart<n>::udreInterrupt(); }
+
+// must be a power of 2
+#define LINE6FBV_USART_TX_BUFFER_SIZE  64
+
+template<uint8_t N>
+class Line6FbvUsart {
+public:
+	typedef Line6FbvNoPort PortType;
+	typedef Line6FbvUsartRegs<N> Regs;
+
+	// bits of UCSRnA / UCSRnB, the same for all USARTs
+	enum { U2X = 1, UDRIE = 5, RXEN = 4, TXEN = 3, RXCIE = 7 };
+
+	inline void begin(Line6FbvNoPort*){
+		// 32150 baud like Line6FbvHardwareSerial, double speed for a smaller error
+		uint16_t ubrr = (F_CPU / 4 / 32150 - 1) / 2;
+		Regs::ucsra() = (1 << U2X);
+		Regs::ubrrh() = ubrr >> 8;
+		Regs::ubrrl() = ubrr;
+		Regs::ucsrc() = 0x06;   // 8N1
+		Regs::ucsrb() = (1 << RXEN) | (1 << TXEN) | (1 << RXCIE);
+	}
+
+	inline void setReceiver(Line6FbvReceiveFunc* inFunc, void* inContext){
+		sContext = inContext;
+		sReceiver = inFunc;
+	}
+
+	// everything is received in the interrupt
+	inline int available(){
+		return 0;
+	}
+
+	inline byte read(){
+		return 0;
+	}
+
+	inline void write(byte inByte){
+		uint8_t next = (sTxHead + 1) & (LINE6FBV_USART_TX_BUFFER_SIZE - 1);
+		while (next == sTxTail){
+			// full, updateUI() checks availableForWrite() so this doesn't happen
+		}
+		sTxBuffer[sTxHead] = inByte;
+		sTxHead = next;
+		uint8_t oldSREG = SREG;
+		cli();
+		Regs::ucsrb() |= (1 << UDRIE);
+		SREG = oldSREG;
+	}
+
+	inline void write(const byte* inBuffer, size_t inLength){
+		while (inLength--)
+			write(*inBuffer++);
+	}
+
+	inline int availableForWrite(){
+		return (sTxTail - sTxHead - 1) & (LINE6FBV_USART_TX_BUFFER_SIZE - 1);
+	}
+
+	static inline void rxInterrupt(){
+		byte inByte = Regs::udr();
+		if (sReceiver)
+			sReceiver(sContext, inByte);
+	}
+
+	static inline void udreInterrupt(){
+		if (sTxHead == sTxTail){
+			Regs::ucsrb() &= ~(1 << UDRIE);
+			return;
+		}
+		Regs::udr() = sTxBuffer[sTxTail];
+		sTxTail = (sTxTail + 1) & (LINE6FBV_USART_TX_BUFFER_SIZE - 1);
+	}
+
+private:
+	static Line6FbvReceiveFunc* volatile sReceiver;
+	static void* volatile sContext;
+	static byte sTxBuffer[LINE6FBV_USART_TX_BUFFER_SIZE];
+	static volatile uint8_t sTxHead;
+	static volatile uint8_t sTxTail;
+};
+
+template<uint8_t N>
+Line6FbvReceiveFunc* volatile Line6FbvUsart<N>::sReceiver = 0;
+template<uint8_t N>
+void* volatile Line6FbvUsart<N>::sContext = 0;
+template<uint8_t N>
+byte Line6FbvUsart<N>::sTxBuffer[LINE6FBV_USART_TX_BUFFER_SIZE];
+template<uint8_t N>
+volatile uint8_t Line6FbvUsart<N>::sTxHead = 0;
+template<uint8_t N>
+volatile uint8_t Line6FbvUsart<N>::sTxTail = 0;
+
+#endif
+
+
+template<class Transport = Line6FbvHardwareSerial, class Profile = Line6FbvLongboard>
 class Line6Fbv {
 public:
 
+	static_assert(Profile::keys[0] == LINE6FBV_KEY_NONE, "the first key of a profile must be LINE6FBV_KEY_NONE");
+	static_assert(Profile::numKeys <= 32, "slot masks are 32 bit");
+	static_assert((LINE6FBV_EVENT_QUEUE_SIZE & (LINE6FBV_EVENT_QUEUE_SIZE - 1)) == 0, "LINE6FBV_EVENT_QUEUE_SIZE must be a power of 2");
+
 
 	// Definitions for callback functions
 	typedef void FunctTypeCbKeyPressed(byte);
@@ -150,33 +835,112 @@ public:
 	typedef void FunctTypeCbHeartbeat();
 	typedef void FunctTypeCbDisconnected();
 	typedef void FunctTypeCbKeyHeld(byte);
+	typedef void FunctTypeCbGesture(byte, byte, byte);
 
 	// just the constructor
 	Line6Fbv();
 
-	void begin(HardwareSerial* inSerial);
+	// open the port, e.g. begin(&Serial1) for the default transport
+	// begin() for transports without a port object (Line6FbvUsart, Line6FbvRingBuffer)
+	void begin(typename Transport::PortType* inPort = 0);
+
+	// the transport object, e.g. to feed and empty a Line6FbvRingBuffer
+	Transport& getTransport();
 
 	// interpret incoming bytes and fire callback functions
+	// same as decode() followed by dispatchEvents()
 	void read();
 
+	// decode incoming bytes into the event queue, no callbacks are fired
+	// nothing to do for a transport that receives in an interrupt
+	void decode();
+
+	// decode one byte, called by decode() or from the RX interrupt of the transport
+	void decodeByte(byte inByte);
+
+	// fire the callbacks for all queued events, check hold times and the connection
+	void dispatchEvents();
+
+	// take the next event from the queue without firing callbacks
+	// (hold, gestures and the connection check are skipped for this event)
+	bool popEvent(Line6FbvEvent& outEvent);
+
+	// events waiting in the queue, events lost because the queue was full
+	uint8_t getPendingEvents();
+	unsigned long getEventOverflows();
+
+	// input the decoder dropped, e.g. to see lost input under load
+	// malformed: invalid length byte, a known opcode with the wrong length,
+	// or a frame cut off by the next 0xF0 (a byte was lost)
+	// unknown: complete frames with an opcode not in line6FbvFrameTypes
+	// resyncs: runs of bytes outside a frame skipped until the next 0xF0
+	unsigned long getRxMalformed();
+	unsigned long getRxUnknown();
+	unsigned long getRxResyncs();
+
+	// micros() when the event being dispatched arrived, e.g. for
+	// micros() - getEventArrival() in a callback after the MIDI message is sent
+	unsigned long getEventArrival();
+	// longest time in micros from the arrival of a frame until its callback
+	unsigned long getMaxEventLatency();
+
 	// switch status of a LED on or off --> updateUI must be called
 	void setLedOnOff(byte inLed, byte inOnOff);
 
+	// switch all LEDs of inMask at once, on where inValues has the bit set --> updateUI must be called
+	// bits are LINE6FBV_LED(key), groups: LINE6FBV_LEDS_CHANNELS, ..._STOMPS, ..._PEDALS etc.
+	// e.g. setLeds(LINE6FBV_LEDS_CHANNELS, LINE6FBV_LED(LINE6FBV_CHANNELB))
+	void setLeds(uint32_t inMask, uint32_t inValues);
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_LED_FLASH)
 	// set staus of  a LED to flash --> updateUI must be called
 	void setLedFlash(byte inLed, int inDelayTime);
 	void setLedFlash(byte inLed, int inDelayTime, int inOnTime);
 
 	void syncLedFlash();
 
+	// let a LED flash with the beat clock --> updateUI must be called
+	// inDivision flashes per beat, each one starts exactly on its subdivision of the beat
+	// the flash phase is calculated from the beat, so it doesn't drift with the loop time
+	void setLedBeat(byte inLed, byte inDivision = 1, int inOnTime = LINE6FBV_FLASH_TIME);
+
+	// time of one beat in ms, the phase is kept
+	void setBeatTime(unsigned int inBeatTime);
+	unsigned int getBeatTime();
+
+	// a beat starts now, e.g. on a tap event of the amp
+	void syncBeat();
+
+	// like syncBeat(), the time since the last tap becomes the beat time
+	void tapBeat();
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_HOLD)
 	// switch status of a LED on or off --> updateUI must be called
 	void setHoldTime(byte inBtn, unsigned int inHoldTime);
+#endif
 
 	// process all LED changes on the FBV at once
 	void updateUI();
 
+	// millis() value of the next flash toggle, hold check, probe or connection check
+	// read() and updateUI() have nothing to do before this time
+	// millis() itself while input or output is waiting (received bytes, events, changed
+	// LEDs or display, frames deferred because the transport was full)
+	unsigned long getNextWakeup();
+
 	// set the 16 character Title --> updateUI must be called
+	// longer titles (up to LINE6FBV_MAX_TITLE_LENGTH) scroll, if setDisplayMarquee() is used
 	void setDisplayTitle(char* inTitle);
 
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_MARQUEE)
+	// let long titles scroll one character every inStepTime ms, 0 turns scrolling off
+	// scrolling pauses inPauseTime ms at both ends and uses at most inBytesPerSecond of the output
+	// it waits while the display flashes or output waits for the transport
+	void setDisplayMarquee(int inStepTime, int inPauseTime = LINE6FBV_MARQUEE_PAUSE,
+		int inBytesPerSecond = LINE6FBV_MARQUEE_BYTES_PER_SECOND);
+#endif
+
 	// set one of the first 4 digits (inNumDigit = 0-3): --> updateUI must be called
 	// the first 3 can be a character '0' - '9' or space
 	// the 4th is used for channels A-D or note names
@@ -192,9 +956,25 @@ public:
 	// display the flat sign (b) --> updateUI must be called
 	void setDisplayFlat(byte inOnOff);
 
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_DISPLAY_FLASH)
 	// let the diusplay light flash --> updateUI must be called
 	// InOnTime == 0 stops flashing{
 	void setDisplayFlash(int inOnTime, int inOffTime);
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_OVERLAYS)
+	// overlays are shown on top of the display set above --> updateUI must be called
+	// inLayer 0 .. LINE6FBV_NUM_OVERLAYS - 1, a higher layer covers the lower ones
+	// only the parts set for an overlay cover the display, the rest stays visible
+	// inTime: the overlay disappears after inTime ms, 0 = until clearDisplayOverlay()
+	// when an overlay disappears only the parts that differ are sent again
+	void setOverlayTitle(byte inLayer, char* inTitle, unsigned int inTime = 0);
+	void setOverlayDigit(byte inLayer, int inNumDigit, char inDigit, unsigned int inTime = 0);
+	void setOverlayDigits(byte inLayer, char* inDigits, unsigned int inTime = 0);
+	void setOverlayNumber(byte inLayer, int inNumber, unsigned int inTime = 0);
+	void setOverlayFlat(byte inLayer, byte inOnOff, unsigned int inTime = 0);
+	void clearDisplayOverlay(byte inLayer);
+#endif
 
 	// set a callback Function for pressed Key
 	void setHandleKeyPressed(FunctTypeCbKeyPressed* cb);
@@ -202,80 +982,340 @@ public:
 	// set a callback Function for released Key
 	void setHandleKeyReleased(FunctTypeCbKeyReleased* cb);
 
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_HOLD)
 	// set a callback Function for held Key
 	void setHandleKeyHeld(FunctTypeCbKeyHeld* cb);
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_GESTURES)
+	// set a callback Function for gestures: key, LINE6FBV_GESTURE_xxx, value
+	void setHandleGesture(FunctTypeCbGesture* cb);
+
+	// Gestures --> setHandleGesture must be used
+	// the timing is set per key, all gestures are driven by deadlines checked by read()
+	// a second press within inTime ms is a double tap, reported in addition to the press
+	void setDoubleTap(byte inKey, unsigned int inTime);
+	// up to LINE6FBV_HOLD_TIERS hold gestures, inTierX ms after the press, 0 = unused
+	void setHoldTiers(byte inKey, unsigned int inTier1, unsigned int inTier2 = 0, unsigned int inTier3 = 0);
+	// while held, repeat every inInterval ms, starting inDelay ms after the press
+	void setAutoRepeat(byte inKey, unsigned int inDelay, unsigned int inInterval);
+	// both keys pressed within LINE6FBV_CHORD_TIME ms: one chord gesture,
+	// no press, release or other gestures for these two presses
+	// a single press of one of the keys is reported LINE6FBV_CHORD_TIME ms late
+	void setChord(byte inKey1, byte inKey2);
+#endif
 
 	// set a callback Function for pedal usage
 	void setHandleCtrlChanged(FunctTypeCbCtrlChanged* cb);
 
 	void setHandleDisconnected(FunctTypeCbDisconnected* cb);
 
+	// a frame was received within the last LINE6FBV_CONNECTION_LOST_TIME ms
+	// or, with probing, the last probe was answered
+	bool isConnected();
+
+	// probe the board with requestPedalPos() when nothing was received for inInterval ms,
+	// LINE6FBV_PROBE_MISSES probes in a row without an answer within inTimeout ms are a
+	// disconnect (inInterval = 0: heartbeat only), the timeout starts when the probe is written
+	// a lost board is probed every LINE6FBV_PROBE_BACKOFF * inInterval ms
+	// every answered probe doubles the interval up to LINE6FBV_PROBE_BACKOFF * inInterval,
+	// key events and pedals that moved start again with inInterval; a pedal
+	// reported with an unchanged position fires no callback
+	void setLivenessProbe(unsigned int inInterval, unsigned int inTimeout = LINE6FBV_PROBE_TIMEOUT);
+
+	// ms from the first frame after a disconnect until all LEDs and the display
+	// were written again, 0 until the first resync is done and while one is running
+	unsigned long getResyncTime();
+
 	// set a callback Function for heartbeat
 	// a heartbeat is sent every 7 seconds
 	// this callback can be used to check the connection status
 	void setHandleHeartbeat(FunctTypeCbHeartbeat* cb);
 
-	void requestBoardType();
-	void requestPedalPos();
+	// queued and written by the next updateUI(), so call it after a request
+	// false if the output buffer is full, the request is dropped and counted by getTxDropped()
+	// the board type is requested once per connection, the answer is not decoded
+	bool requestBoardType();
+	bool requestPedalPos();
+
+	// last position (0 - 127) of pedal LINE6FBV_CC_PDL1 or LINE6FBV_CC_PDL2, LINE6FBV_PEDAL_UNKNOWN before the first report
+	// both positions are requested when the board connects and the answer fires the
+	// ctrl changed callback for a position not known before, so a sketch has the real
+	// position without moving the pedal
+	byte getPedalPos(byte inPedal);
+
+	// LEDs, switches and pedals of the Profile, the FBV doesn't report its model
+	// LEDs the profile doesn't have are not sent
+	const Line6FbvBoardInfo& getBoardInfo();
+
+	// bytes and frames written to the transport by the last call of updateUI()
+	unsigned int getTxBytes();
+	byte getTxFrames();
+
+	// LED frames not sent, because the FBV already shows that state
+	unsigned long getSuppressedFrames();
+
+	// periods in which updateUI() had to defer frames, because the transport was full,
+	// counted once when such a period starts
+	unsigned long getTxDeferrals();
+	// time in ms frames waited for the transport, in total and the longest wait
+	unsigned long getTxBlockedTime();
+	unsigned long getTxMaxBlockedTime();
+	// frames dropped, because the output buffer was full
+	unsigned long getTxDropped();
 
 
 private:
 
 	FunctTypeCbKeyPressed*		mCbKeyPressed;
 	FunctTypeCbKeyReleased*		mCbKeyReleased;
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_HOLD)
 	FunctTypeCbKeyHeld*			mCbKeyHeld;
+#endif
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_GESTURES)
+	FunctTypeCbGesture*			mCbGesture;
+#endif
 	FunctTypeCbCtrlChanged*		mCbCtrlChanged;
 	FunctTypeCbHeartbeat*		mCbHeartbeat;
 	FunctTypeCbDisconnected*  mCbDisconnected;
 
-	struct LedAndSwitch{
-		byte key;
-		int onTime;
-		int offTime;
-		int waitTime;
-		unsigned long lastMillis;
-		byte isOn;
-		byte setOn;
-		byte setOff;
-		byte flash;
-		int holdTime;
-		unsigned long lastPressTime;
-		byte isHeld;
-		byte isPressed;
-	};
-
 	struct Display{
 		char numDigits[3];
 		char noteDigit;
 		byte flat;
 		char title[16];
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_DISPLAY_FLASH)
 		int onTime;
 		int offTime;
-		int waitTime;
-		unsigned long lastMillis;
+		unsigned long due;
 		byte isShown;
 		byte flash;
-	
+#endif
+	};
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_OVERLAYS)
+	struct Overlay{
+		char digits[4];
+		byte flat;
+		char title[16];
+		byte segments;       // LINE6FBV_SEG_xxx covered, 0 = not shown
+		byte timed;
+		unsigned long until;
 	};
+#endif
 
 	Display mDisplay;
-	Display mDisplayEmpty;  // for flashing
-	byte mDisplayDataChanged;  // send only changes
-	LedAndSwitch mLedAndSwitch[LINE6FBV_NUM_LED_AND_SWITCH];
-	HardwareSerial * mSerial;
+	byte mDisplayDirty;  // LINE6FBV_SEG_xxx, send only changes
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_GESTURES)
+	// gesture configuration and state of one key
+	struct KeyGesture{
+		uint8_t slot;              // 0 = unused
+		uint8_t chordSlot;         // other key of the chord, 0 = none
+		uint16_t doubleTapTime;
+		uint16_t holdTiers[LINE6FBV_HOLD_TIERS];
+		uint16_t repeatDelay;
+		uint16_t repeatInterval;
+		uint8_t nextTier;
+		uint8_t repeatCount;
+		uint8_t state;             // LINE6FBV_GST_xxx
+		unsigned long lastTap;
+	};
+
+	KeyGesture mGestures[LINE6FBV_NUM_GESTURE_KEYS];
+	uint8_t mGestureArmed;     // one bit per entry of mGestures waiting for a deadline
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_OVERLAYS)
+	Overlay mOverlays[LINE6FBV_NUM_OVERLAYS];
+	byte mOverlaySegments;  // segments covered by any overlay
+#endif
+
+	// what the FBV display actually shows
+	char mShownDigits[4];
+	byte mShownFlat;
+	char mShownTitle[16];
+	byte mShownKnown;    // LINE6FBV_SEG_xxx of mShownDigits, mShownFlat and mShownTitle
+
+	// state of the switches and LEDs, one bit per slot of the profile
+	// slot 0 is LINE6FBV_KEY_NONE
+	uint32_t mLedOnMask;        // LED is on, for flashing LEDs the actual phase
+	uint32_t mLedPendingMask;   // set by setLedOnOff(), sent by updateUI()
+	uint32_t mLedDirtyMask;     // mLedOnMask may differ from the FBV, not sent yet
+	uint32_t mLedSetOnMask;     // value of the pending LEDs
+	uint32_t mLedShownMask;     // state the FBV actually shows,
+	uint32_t mLedKnownMask;     // valid for the slots set here
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_HOLD)
+	uint32_t mPressedMask;
+	uint32_t mHeldMask;
+	uint32_t mHoldMask;         // pressed keys waiting for the hold time
+	uint16_t mHoldTime[Profile::numKeys];
+	unsigned long mPressTime[Profile::numKeys];
+	unsigned long mNextHoldDue; // earliest hold time
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_LED_FLASH)
+	// timing, one entry per slot
+	uint32_t mFlashMask;        // flashing LEDs
+	uint16_t mFlashOnTime[Profile::numKeys];
+	uint16_t mFlashOffTime[Profile::numKeys];
+	unsigned long mFlashDue[Profile::numKeys];   // next flash toggle
+
+	// beat clock, mBeatAnchor is the start of the current (or a recent) beat
+	uint32_t mBeatMask;         // flashing LEDs linked to the beat
+	uint8_t mBeatDivision[Profile::numKeys];
+	unsigned int mBeatTime;
+	unsigned long mBeatAnchor;
+	unsigned long mLastTap;
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_MARQUEE)
+	// scrolling title
+	char mLongTitle[LINE6FBV_MAX_TITLE_LENGTH];
+	uint8_t mLongTitleLength;   // 0: the title doesn't scroll
+	uint8_t mMarqueePos;        // first character shown
+	unsigned int mMarqueeStepTime;
+	unsigned int mMarqueePauseTime;
+	unsigned int mMarqueeBytesPerSecond;
+	unsigned long mMarqueeDue;
+	unsigned long mMarqueeCredit;      // bytes * 1000 the marquee may send
+	unsigned long mMarqueeCreditTime;
+#endif
+
+	unsigned long mNextUiDue;   // earliest flash toggle (LEDs and display)
+	Transport mTransport;
+	byte mTxBuffer[LINE6FBV_TX_BUFFER_SIZE];
+	uint8_t mTxLength;
+	unsigned int mTxBytes;
+	byte mTxFrames;
+	unsigned int mLastTxBytes;
+	byte mLastTxFrames;
+	unsigned long mSuppressedFrames;
+	unsigned long mTxDeferrals;
+	unsigned long mTxBlockedSince;
+	unsigned long mTxBlockedTime;
+	unsigned long mTxMaxBlockedTime;
+	unsigned long mTxDropped;
+	byte mTxBlocked;
+	// single producer (decode) / single consumer (dispatchEvents) queue
+	// each index is written by one side only
+	Line6FbvEvent mEvents[LINE6FBV_EVENT_QUEUE_SIZE];
+	volatile uint8_t mEventHead;   // written by decode()
+	volatile uint8_t mEventTail;   // written by popEvent()
+	unsigned long mEventOverflows;
+	unsigned long mEventArrival;
+	unsigned long mMaxEventLatency;
+
+	// connection state of this link, each object watches its own board
+	bool mConnected;
+	unsigned long mLastConnectionCheck;
+	void mLinkLost();
+
+	// nothing is sent while the board is lost, the first frame starts a resync
+	byte mOffline;
+	byte mResyncing;
+	unsigned long mResyncSince;
+	unsigned long mResyncTime;
+	void mStartResync(unsigned long inNow);
+
+	Line6FbvBoardInfo mBoardInfo;
+	uint32_t mBoardLedSlots;   // slots with a LED on the board of the profile
+	void mSetBoardInfo();
+
+	// active liveness probing, mProbeWait is the current interval
+	unsigned int mProbeInterval;
+	unsigned int mProbeTimeout;
+	unsigned int mProbeWait;
+	unsigned long mProbeSince;   // when the last probe was written
+	byte mProbePending;          // 0, LINE6FBV_PROBE_QUEUED or LINE6FBV_PROBE_SENT
+	byte mProbeMisses;           // unanswered probes in a row
+	byte mPedalValue[2];   // last value of pedal 1 and 2, LINE6FBV_PEDAL_UNKNOWN
+	void mCheckProbe();
+	unsigned long mProbeDue(unsigned long inNow);
+
+	// frame being decoded, only the first bytes are kept, longer frames are skipped
 	byte mDataBytes[5];
-	int mByteCount;
-	int mBytesExpected;
+	uint8_t mByteCount;       // bytes of the frame received, 0 = waiting for 0xF0
+	uint8_t mBytesExpected;   // length byte + 2, 0 until the length byte arrived
+	byte mRxSkipping;         // bytes outside a frame are being skipped
+	unsigned long mRxMalformed;
+	unsigned long mRxUnknown;
+	unsigned long mRxResyncs;
+	void mFrameDecoded();
+
+	// send Number, Note, Title to the display, as far as ioSpace bytes allow
+	void sendDisplayData(const Display& inDisplay, int& ioSpace);
 
-	// send Number, Note, Title to the display
-	void sendDisplayData(Display inDisplay);
+	// output is collected in mTxBuffer and written by mFlushTx()
+	bool mQueueFrame(const byte* inFrame, uint8_t inLength);
+	void mSendLeds(int& ioSpace, uint32_t inMask);
+	void mFlushTx(int& ioSpace);
 
-	void mStartHold(byte inKey);
+	void mPushEvent(byte inLength, byte inOpcode, byte inData1, byte inData2);
+	static void mReceive(void* inContext, byte inByte);
+
+	// without the feature these do nothing and are optimized away
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_HOLD)
+	void mStartHold(byte inKey, unsigned long inTime);
 	byte mStopHold(byte inKey);
 	void mCheckHold();
+	void mScheduleKeyTimer(unsigned long inDue);
+	bool mKeyTimersArmed();
+#else
+	void mStartHold(byte, unsigned long){}
+	byte mStopHold(byte){ return 0; }
+	void mCheckHold(){}
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_GESTURES)
+	KeyGesture* mGestureOf(uint8_t inSlot, bool inCreate);
+	bool mGesturePress(uint8_t inSlot);
+	bool mGestureRelease(uint8_t inSlot);
+	void mGestureTimer(uint8_t inIndex, unsigned long inNow);
+	unsigned long mGestureDue(const KeyGesture& inGesture, bool& outArmed);
+#else
+	bool mGesturePress(uint8_t){ return false; }
+	bool mGestureRelease(uint8_t){ return false; }
+#endif
+
+	void mRunFlashTimers(unsigned long inNow);
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_LED_FLASH)
+	void mRunBeatTimers(unsigned long inNow);
+#endif
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_MARQUEE)
+	void mStepMarquee(unsigned long inNow);
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_OVERLAYS)
+	// overlays
+	Overlay* mUseOverlay(byte inLayer, byte inSegments, unsigned int inTime);
+	void mUpdateOverlaySegments();
+	void mComposeDisplay(Display& outDisplay);
+#endif
+
+	// all digits and the title blank, the flat sign off
+	static void mBlankDisplay(Display& outDisplay);
+
+	static void mNumberToDigits(int inNumber, char* outDigits);
+	void mScheduleUi(unsigned long inDue);
 
 	uint8_t mGetLedInArray(byte inCC);
 
+	static inline uint32_t mSlotBit(uint8_t inSlot){
+		return 1UL << inSlot;
+	}
+
+	static inline uint8_t mCountBits(uint32_t inMask){
+		uint8_t count = 0;
+		for (; inMask; inMask &= inMask - 1)
+			count++;
+		return count;
+	}
+
 	
 };
+
+#include "Line6Fbv.hpp"
+
 #endif
@@ -0,0 +1,1710 @@
+/*!
+*  @file       Line6Fbv.hpp
+*  Project     Arduino Line6 FBV Longboard to MIDI Library
+*  @brief      Line6 FBV Library for the Arduino
+*  @version    1.1
+*  @author     Joachim Wrba
+*  @date       15/10/16
+*  @license    GPL v3.0
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// implementation of the class template Line6Fbv, included by Line6Fbv.h
+
+template<class Transport, class Profile>
+Line6Fbv<Transport, Profile>::Line6Fbv() {
+
+
+
+	mCbKeyPressed = 0;
+	mCbKeyReleased = 0;
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_HOLD)
+	mCbKeyHeld = 0;
+#endif
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_GESTURES)
+	mCbGesture = 0;
+#endif
+	mCbCtrlChanged = 0;
+	mCbHeartbeat = 0;
+	mCbDisconnected = 0;
+
+	mTxLength = 0;
+	mTxBytes = 0;
+	mTxFrames = 0;
+	mLastTxBytes = 0;
+	mLastTxFrames = 0;
+	mSuppressedFrames = 0;
+	mTxDeferrals = 0;
+	mTxBlockedSince = 0;
+	mTxBlockedTime = 0;
+	mTxMaxBlockedTime = 0;
+	mTxDropped = 0;
+	mTxBlocked = 0;
+
+	mLedPendingMask = 0;
+	mLedDirtyMask = 0;
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_LED_FLASH)
+	mFlashMask = 0;
+	mBeatMask = 0;
+	mBeatTime = LINE6FBV_BEAT_TIME;
+	mBeatAnchor = 0;
+	mLastTap = 0;
+#endif
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_MARQUEE)
+	mLongTitleLength = 0;
+	mMarqueePos = 0;
+	mMarqueeStepTime = 0;
+	mMarqueePauseTime = LINE6FBV_MARQUEE_PAUSE;
+	mMarqueeBytesPerSecond = LINE6FBV_MARQUEE_BYTES_PER_SECOND;
+	mMarqueeDue = 0;
+	mMarqueeCredit = 0;
+	mMarqueeCreditTime = 0;
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_GESTURES)
+	for (uint8_t i = 0; i < LINE6FBV_NUM_GESTURE_KEYS; i++){
+		mGestures[i].slot = 0;
+	}
+	mGestureArmed = 0;
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_OVERLAYS)
+	for (uint8_t i = 0; i < LINE6FBV_NUM_OVERLAYS; i++){
+		mOverlays[i].segments = 0;
+	}
+	mOverlaySegments = 0;
+#endif
+
+	mNextUiDue = LINE6FBV_MAX_SLEEP;
+
+	mEventHead = 0;
+	mEventTail = 0;
+	mEventOverflows = 0;
+	mEventArrival = 0;
+	mMaxEventLatency = 0;
+
+	mConnected = false;
+	mLastConnectionCheck = 0;
+	mOffline = 0;
+	mResyncing = 0;
+	mResyncSince = 0;
+	mResyncTime = 0;
+	mSetBoardInfo();
+
+	mProbeInterval = 0;
+	mProbeTimeout = LINE6FBV_PROBE_TIMEOUT;
+	mProbeWait = 0;
+	mProbeSince = 0;
+	mProbePending = 0;
+	mProbeMisses = 0;
+	mPedalValue[0] = LINE6FBV_PEDAL_UNKNOWN;
+	mPedalValue[1] = LINE6FBV_PEDAL_UNKNOWN;
+
+	mDataBytes[0] = 0;
+	mByteCount = 0;
+	mBytesExpected = 0;
+	mRxSkipping = 0;
+	mRxMalformed = 0;
+	mRxUnknown = 0;
+	mRxResyncs = 0;
+
+	
+
+
+	mLedOnMask = 0;
+	mLedSetOnMask = 0;
+	mLedShownMask = 0;
+	mLedKnownMask = 0;
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_HOLD)
+	mPressedMask = 0;
+	mHeldMask = 0;
+	mHoldMask = 0;
+	for (uint8_t i = 0; i < Profile::numKeys; i++){
+		mHoldTime[i] = 0;
+	}
+	mNextHoldDue = LINE6FBV_MAX_SLEEP;
+#endif
+
+	mBlankDisplay(mDisplay);
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_DISPLAY_FLASH)
+	mDisplay.flash = 0;
+	mDisplay.isShown = 1;
+#endif
+	mDisplayDirty = LINE6FBV_SEG_ALL;
+	mShownKnown = 0;
+
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::begin(typename Transport::PortType * inPort) {
+	mTransport.setReceiver(&Line6Fbv::mReceive, this);
+	mTransport.begin(inPort);
+}
+
+template<class Transport, class Profile>
+Transport& Line6Fbv<Transport, Profile>::getTransport() {
+	return mTransport;
+}
+
+// called by transports that receive in an interrupt
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mReceive(void* inContext, byte inByte) {
+	static_cast<Line6Fbv*>(inContext)->decodeByte(inByte);
+}
+
+template<class Transport, class Profile>
+bool Line6Fbv<Transport, Profile>::requestBoardType(void) {
+	byte frame[] = { 0xF0, 0x02, 0x01, 0x00 };
+	return mQueueFrame(frame, sizeof(frame));
+}
+
+template<class Transport, class Profile>
+bool Line6Fbv<Transport, Profile>::requestPedalPos(void) {
+	byte frame[] = { 0xF0, 0x02, 0x01, 0x01 };
+	return mQueueFrame(frame, sizeof(frame));
+}
+
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setHandleKeyPressed(FunctTypeCbKeyPressed* cb) {
+	mCbKeyPressed = cb;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setHandleKeyReleased(FunctTypeCbKeyReleased* cb) {
+	mCbKeyReleased = cb;
+}
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_HOLD)
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setHandleKeyHeld(FunctTypeCbKeyHeld* cb) {
+	mCbKeyHeld = cb;
+}
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_GESTURES)
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setHandleGesture(FunctTypeCbGesture* cb) {
+	mCbGesture = cb;
+}
+#endif
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setHandleCtrlChanged(FunctTypeCbCtrlChanged* cb) {
+	mCbCtrlChanged = cb;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setHandleHeartbeat(FunctTypeCbHeartbeat* cb) {
+	mCbHeartbeat = cb;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setHandleDisconnected(FunctTypeCbDisconnected* cb) {
+	mCbDisconnected = cb;
+}
+
+
+template<class Transport, class Profile>
+bool Line6Fbv<Transport, Profile>::isConnected() {
+	return mConnected;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setLivenessProbe(unsigned int inInterval, unsigned int inTimeout) {
+	mProbeInterval = inInterval;
+	mProbeTimeout = inTimeout;
+	mProbeWait = inInterval;
+	mProbePending = 0;
+	mProbeMisses = 0;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mLinkLost() {
+	mConnected = false;
+	mOffline = 1;
+	mTxLength = 0;   // nothing but probes is sent to a lost board
+	mProbePending = 0;
+	mProbeSince = millis();
+	mProbeWait = LINE6FBV_PROBE_BACKOFF * mProbeInterval;
+	mDisplayDirty = LINE6FBV_SEG_ALL;
+	if (mCbDisconnected)
+		mCbDisconnected();
+}
+
+// the board (re)appeared: send the complete state, the board may have lost all of it
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mStartResync(unsigned long inNow) {
+	mOffline = 0;
+	mTxLength = 0;   // frames for the lost board, the resync replaces them
+	// the board may come back dark or still show an old state, and frames sent before
+	// the first connection went nowhere: nothing it shows is known
+	mLedDirtyMask = ((mSlotBit(Profile::numKeys - 1) << 1) - 1) & ~mSlotBit(0);
+	mLedKnownMask = 0;
+	mShownKnown = 0;
+	mDisplayDirty = LINE6FBV_SEG_ALL;
+	mResyncing = 1;
+	mResyncSince = inNow;
+	mResyncTime = 0;
+	mProbePending = 0;   // the frame answered it, a queued one is gone with the buffer
+	mProbeMisses = 0;
+	mProbeWait = mProbeInterval;
+
+	// the pedals may have moved
+	requestBoardType();
+	requestPedalPos();
+}
+
+template<class Transport, class Profile>
+byte Line6Fbv<Transport, Profile>::getPedalPos(byte inPedal) {
+	if (inPedal > LINE6FBV_CC_PDL2)
+		return LINE6FBV_PEDAL_UNKNOWN;
+	return mPedalValue[inPedal];
+}
+
+template<class Transport, class Profile>
+const Line6FbvBoardInfo& Line6Fbv<Transport, Profile>::getBoardInfo() {
+	return mBoardInfo;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mSetBoardInfo() {
+	mBoardInfo.leds = Profile::ledMask();
+	mBoardInfo.switches = Profile::switchMask();
+	mBoardInfo.pedals = Profile::numPedals();
+
+	mBoardLedSlots = 0;
+	for (uint8_t i = 1; i < Profile::numKeys; i++){
+		if (mBoardInfo.leds & (1UL << Profile::keyOfSlot(i)))
+			mBoardLedSlots |= mSlotBit(i);
+	}
+}
+
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::getResyncTime() {
+	return mResyncTime;
+}
+
+// send a probe when the link was quiet for mProbeWait ms, check the answer
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mCheckProbe() {
+	unsigned long now = millis();
+	if (mProbePending == LINE6FBV_PROBE_SENT){
+		if (now - mProbeSince <= mProbeTimeout)
+			return;
+		mProbePending = 0;
+		if (mProbeMisses < 255)
+			mProbeMisses++;
+		if (mConnected && mProbeMisses >= LINE6FBV_PROBE_MISSES){
+			mLinkLost();
+			return;
+		}
+	}
+	// frames waiting for the transport would delay the answer, the next call probes
+	if (!mProbePending && !mTxLength && (long)(now - mProbeDue(now)) >= 0){
+		requestPedalPos();
+		mProbePending = LINE6FBV_PROBE_QUEUED;
+	}
+}
+
+// when the next probe is due, or its answer, if one was written
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::mProbeDue(unsigned long inNow) {
+	if (mProbePending == LINE6FBV_PROBE_SENT)
+		return mProbeSince + mProbeTimeout + 1;
+	if (mProbePending)
+		return inNow;   // written by the next updateUI()
+	if (!mConnected)
+		return mProbeSince + mProbeWait;   // lost, at the backoff rate
+	if (mProbeMisses)
+		return inNow;   // unanswered, ask again right away
+	return mLastConnectionCheck + mProbeWait;
+}
+
+
+template<class Transport, class Profile>
+uint8_t Line6Fbv<Transport, Profile>::mGetLedInArray(byte inCC){
+	// table generated at compile time from the profile, unknown codes give slot 0
+	return Profile::slotOfCode(inCC);
+};
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setLedOnOff(byte inLed, byte inOnOff) {
+
+	// Find the Switch in the array and set the value
+	uint8_t i = Profile::slotOfKey(inLed);
+	if (!i)
+		return;   // not on this board
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_LED_FLASH)
+	mFlashMask &= ~mSlotBit(i);
+	mBeatMask &= ~mSlotBit(i);
+#endif
+	mLedPendingMask |= mSlotBit(i);
+	if (inOnOff)
+		mLedSetOnMask |= mSlotBit(i);
+	else
+		mLedSetOnMask &= ~mSlotBit(i);
+
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setLeds(uint32_t inMask, uint32_t inValues) {
+
+	// same as setLedOnOff() for all slots at once
+	uint32_t slots = Profile::slotsOfKeys(inMask);
+	uint32_t on = Profile::slotsOfKeys(inMask & inValues);
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_LED_FLASH)
+	mFlashMask &= ~slots;
+	mBeatMask &= ~slots;
+#endif
+	mLedPendingMask |= slots;
+	mLedSetOnMask = (mLedSetOnMask & ~slots) | on;
+}
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_HOLD)
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setHoldTime(byte inBtn, unsigned int inHoldTime){
+	uint8_t i = Profile::slotOfKey(inBtn);
+	if (i)
+		mHoldTime[i] = inHoldTime;
+}
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_LED_FLASH)
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::syncLedFlash() {
+	unsigned long currentMillis = millis();
+	uint32_t flashing = mFlashMask & ~mBeatMask;   // beat LEDs follow syncBeat()
+	for (uint8_t i = 1; i < Profile::numKeys; i++){
+		if (flashing & mSlotBit(i))
+			mFlashDue[i] = currentMillis;
+	}
+	mLedOnMask &= ~flashing;
+	mScheduleUi(currentMillis);
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setLedFlash(byte inLed, int inDelayTime) {
+	setLedFlash(inLed, inDelayTime, LINE6FBV_FLASH_TIME);
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setLedFlash(byte inLed, int inDelayTime, int inOnTime) {
+
+	uint8_t i = Profile::slotOfKey(inLed);
+	if (!i)
+		return;   // not on this board
+
+	mLedOnMask &= ~mSlotBit(i);
+	mLedPendingMask &= ~mSlotBit(i);
+	mBeatMask &= ~mSlotBit(i);
+	mFlashMask |= mSlotBit(i);
+	mFlashDue[i] = millis();   // first toggle with the next updateUI()
+	mScheduleUi(mFlashDue[i]);
+	if (inDelayTime > inOnTime){
+		mFlashOffTime[i] = inDelayTime - inOnTime; // ToDo intervals < 50 ms
+		mFlashOnTime[i] = inOnTime;
+	}
+	else{
+		mFlashOffTime[i] = inDelayTime / 2;
+		mFlashOnTime[i] = inDelayTime / 2;
+	}
+}
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setLedBeat(byte inLed, byte inDivision, int inOnTime) {
+
+	uint8_t i = Profile::slotOfKey(inLed);
+	if (!i || !inDivision)
+		return;
+
+	mLedPendingMask &= ~mSlotBit(i);
+	mFlashMask |= mSlotBit(i);
+	mBeatMask |= mSlotBit(i);
+	mBeatDivision[i] = inDivision;
+	mFlashOnTime[i] = inOnTime;
+	mScheduleUi(millis());
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setBeatTime(unsigned int inBeatTime) {
+	if (!inBeatTime)
+		return;
+	// keep the phase: move the anchor to the start of the current beat first
+	unsigned long currentMillis = millis();
+	mBeatAnchor += (currentMillis - mBeatAnchor) / mBeatTime * mBeatTime;
+	mBeatTime = inBeatTime;
+	mScheduleUi(currentMillis);
+}
+
+template<class Transport, class Profile>
+unsigned int Line6Fbv<Transport, Profile>::getBeatTime() {
+	return mBeatTime;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::syncBeat() {
+	mBeatAnchor = millis();
+	mScheduleUi(mBeatAnchor);
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::tapBeat() {
+	unsigned long currentMillis = millis();
+	unsigned long sinceLastTap = currentMillis - mLastTap;
+	mLastTap = currentMillis;
+	if (sinceLastTap >= LINE6FBV_MIN_TAP_TIME && sinceLastTap <= LINE6FBV_MAX_TAP_TIME)
+		mBeatTime = sinceLastTap;
+	syncBeat();
+}
+#endif
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::updateUI(){
+
+	unsigned long currentMillis = millis();
+
+	// LEDs set by setLedOnOff(), slot 0 is LINE6FBV_KEY_NONE
+	uint32_t pending = mLedPendingMask;
+	mLedPendingMask = 0;
+	mLedOnMask = (mLedOnMask & ~pending) | (mLedSetOnMask & pending);
+	mLedDirtyMask |= pending;
+
+	// flashing LEDs and display, only when the earliest toggle is due
+	if ((long)(currentMillis - mNextUiDue) >= 0)
+		mRunFlashTimers(currentMillis);
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_DISPLAY_FLASH)
+	// Display
+	if (!mDisplay.flash && !mDisplay.isShown){
+		mDisplay.isShown = 1;
+		mDisplayDirty = LINE6FBV_SEG_ALL;   // flashing stopped while dark
+	}
+#endif
+
+	// the state is kept and sent completely when the board is back, only probes go out
+	if (mOffline){
+		int space = mTransport.availableForWrite();
+		mFlushTx(space);
+		mLastTxBytes = mTxBytes;
+		mLastTxFrames = mTxFrames;
+		mTxBytes = 0;
+		mTxFrames = 0;
+		return;
+	}
+
+	// only what fits into the transport without blocking:
+	// frames left from the last call, then LEDs, then the display
+	// a resync sends the LEDs that are on first, the ones that are off last
+	int space = mTransport.availableForWrite();
+	mFlushTx(space);
+	int budget = mTxLength ? 0 : space;   // 0: the next frame waiting is still too long
+	if (budget > LINE6FBV_TX_BUDGET)
+		budget = LINE6FBV_TX_BUDGET;   // a larger TX ring, the rest next call
+
+	mSendLeds(budget, mResyncing ? mLedOnMask : 0xFFFFFFFF);
+	if (mDisplayDirty){
+		const Display* shown = &mDisplay;
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_OVERLAYS | LINE6FBV_FEATURE_DISPLAY_FLASH)
+		Display composed;
+#endif
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_OVERLAYS)
+		if (mOverlaySegments){
+			mComposeDisplay(composed);
+			shown = &composed;
+		}
+#endif
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_DISPLAY_FLASH)
+		if (!mDisplay.isShown){
+			mBlankDisplay(composed);   // dark phase of the flashing display
+			shown = &composed;
+		}
+#endif
+		sendDisplayData(*shown, budget);
+	}
+	if (mResyncing)
+		mSendLeds(budget, 0xFFFFFFFF);
+
+	// all frames of this call at once
+	mFlushTx(space);
+	mLastTxBytes = mTxBytes;
+	mLastTxFrames = mTxFrames;
+	mTxBytes = 0;
+	mTxFrames = 0;
+
+	// count how often and how long output had to wait
+	if (mTxLength || mLedDirtyMask || mDisplayDirty){
+		if (!mTxBlocked){
+			mTxBlocked = 1;
+			mTxBlockedSince = currentMillis;
+			mTxDeferrals++;
+		}
+	}
+	else{
+		if (mTxBlocked){
+			unsigned long blocked = currentMillis - mTxBlockedSince;
+			mTxBlocked = 0;
+			mTxBlockedTime += blocked;
+			if (blocked > mTxMaxBlockedTime)
+				mTxMaxBlockedTime = blocked;
+		}
+		if (mResyncing){
+			mResyncing = 0;
+			mResyncTime = currentMillis - mResyncSince;
+			if (!mResyncTime)
+				mResyncTime = 1;   // 0 means still running
+		}
+	}
+}
+
+// toggle all flashing LEDs and the display light that are due, find the next deadline
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mRunFlashTimers(unsigned long inNow){
+
+	mNextUiDue = inNow + LINE6FBV_MAX_SLEEP;
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_LED_FLASH)
+	uint32_t flashing = mFlashMask & ~mBeatMask;
+	for (uint8_t i = 1; i < Profile::numKeys && (flashing >> i); i++){
+		if (!(flashing & mSlotBit(i)))
+			continue;
+		//Serial.print("LED flash  : ");
+		//Serial.println(Profile::codeOfSlot(i), HEX);
+		if ((long)(inNow - mFlashDue[i]) >= 0) {
+			// the next toggle is counted from the last one, not from now,
+			// a late updateUI() doesn't shift the following toggles
+			mFlashDue[i] += (mLedOnMask & mSlotBit(i)) ? mFlashOffTime[i] : mFlashOnTime[i];
+			if ((long)(inNow - mFlashDue[i]) >= 0)   // far behind (or started), start again from now
+				mFlashDue[i] = inNow + ((mLedOnMask & mSlotBit(i)) ? mFlashOffTime[i] : mFlashOnTime[i]);
+			mLedOnMask ^= mSlotBit(i);
+			mLedDirtyMask |= mSlotBit(i);
+		}
+		mScheduleUi(mFlashDue[i]);
+	}
+
+	if (mBeatMask)
+		mRunBeatTimers(inNow);
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_OVERLAYS)
+	// overlays that time out, the segments they covered are compared again
+	for (uint8_t l = 0; l < LINE6FBV_NUM_OVERLAYS; l++){
+		if (mOverlays[l].segments && mOverlays[l].timed){
+			if ((long)(inNow - mOverlays[l].until) >= 0)
+				clearDisplayOverlay(l);
+			else
+				mScheduleUi(mOverlays[l].until);
+		}
+	}
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_MARQUEE)
+	if (mLongTitleLength){
+		if ((long)(inNow - mMarqueeDue) >= 0)
+			mStepMarquee(inNow);
+		mScheduleUi(mMarqueeDue);
+	}
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_DISPLAY_FLASH)
+	if (mDisplay.flash){
+		if ((long)(inNow - mDisplay.due) >= 0) {
+			if (!mDisplay.isShown)
+				mDisplay.due = inNow + mDisplay.onTime;
+			else
+				mDisplay.due = inNow + mDisplay.offTime;
+
+			mDisplay.isShown = !mDisplay.isShown;
+
+			mDisplayDirty = LINE6FBV_SEG_ALL;   // sent by updateUI()
+		}
+		mScheduleUi(mDisplay.due);
+	}
+#endif
+}
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_LED_FLASH)
+// LEDs linked to the beat clock
+// the state of each LED is calculated from the position in the beat, there is no
+// rescheduling from the previous toggle, so the error is never larger than the loop time
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mRunBeatTimers(unsigned long inNow){
+
+	// move the anchor to the start of the current beat
+	unsigned long elapsed = inNow - mBeatAnchor;
+	if (elapsed >= mBeatTime){
+		mBeatAnchor += elapsed / mBeatTime * mBeatTime;
+		elapsed = inNow - mBeatAnchor;
+	}
+
+	uint32_t flashing = mBeatMask;
+	for (uint8_t i = 1; i < Profile::numKeys && (flashing >> i); i++){
+		if (!(flashing & mSlotBit(i)))
+			continue;
+
+		// subdivision of the beat we are in, and its start and end
+		unsigned long sub = elapsed * mBeatDivision[i] / mBeatTime;
+		unsigned long start = sub * mBeatTime / mBeatDivision[i];
+		unsigned long end = (sub + 1) * mBeatTime / mBeatDivision[i];
+		unsigned long onEnd = start + mFlashOnTime[i];
+		if (onEnd > start + (end - start) / 2)
+			onEnd = start + (end - start) / 2;
+
+		byte on = elapsed < onEnd;
+		if (((mLedOnMask & mSlotBit(i)) != 0) != on){
+			mLedOnMask ^= mSlotBit(i);
+			mLedDirtyMask |= mSlotBit(i);
+		}
+		mScheduleUi(mBeatAnchor + (on ? onEnd : end));
+	}
+}
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_MARQUEE)
+// move the scrolling title one character
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mStepMarquee(unsigned long inNow){
+
+	// the flashing display, an overlay on the title and output waiting for
+	// the transport go first, try again later
+	byte busy = mTxBlocked;
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_DISPLAY_FLASH)
+	busy |= mDisplay.flash;
+#endif
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_OVERLAYS)
+	busy |= mOverlaySegments & LINE6FBV_SEG_TITLE;
+#endif
+	if (busy){
+		mMarqueeDue = inNow + mMarqueeStepTime;
+		return;
+	}
+
+	// byte budget: each step sends one title frame (21 bytes)
+	const unsigned long cost = 21 * 1000UL;
+	unsigned long elapsed = inNow - mMarqueeCreditTime;
+	mMarqueeCreditTime = inNow;
+	if (elapsed > 2000)
+		elapsed = 2000;
+	mMarqueeCredit += elapsed * mMarqueeBytesPerSecond;
+	if (mMarqueeCredit > 2 * cost)
+		mMarqueeCredit = 2 * cost;
+	if (mMarqueeCredit < cost){
+		mMarqueeDue = inNow + (cost - mMarqueeCredit) / mMarqueeBytesPerSecond + 1;
+		return;
+	}
+	mMarqueeCredit -= cost;
+
+	uint8_t lastPos = mLongTitleLength - 16;
+	if (mMarqueePos >= lastPos){
+		mMarqueePos = 0;   // back to the start
+		mMarqueeDue = inNow + mMarqueePauseTime;
+	}
+	else{
+		mMarqueePos++;
+		mMarqueeDue = inNow + (mMarqueePos == lastPos ? mMarqueePauseTime : mMarqueeStepTime);
+	}
+
+	// only a changed window is sent (see sendDisplayData())
+	memcpy(mDisplay.title, &mLongTitle[mMarqueePos], 16);
+	mDisplayDirty |= LINE6FBV_SEG_TITLE;
+}
+#endif
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mScheduleUi(unsigned long inDue){
+	if ((long)(inDue - mNextUiDue) < 0)
+		mNextUiDue = inDue;
+}
+
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::getNextWakeup(){
+	unsigned long now = millis();
+	// waiting input or output, the next calls have work right now
+	if (mTransport.available() || mEventHead != mEventTail || mTxLength || mLedPendingMask)
+		return now;
+	if (!mOffline && (mLedDirtyMask || mDisplayDirty))
+		return now;
+
+	unsigned long due = mNextUiDue;
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_HOLD)
+	if (mKeyTimersArmed() && (long)(mNextHoldDue - due) < 0)
+		due = mNextHoldDue;
+#endif
+	if (mConnected){
+		unsigned long lostDue = mLastConnectionCheck + LINE6FBV_CONNECTION_LOST_TIME + 1;
+		if ((long)(lostDue - due) < 0)
+			due = lostDue;
+	}
+	if ((mConnected || mOffline) && mProbeInterval){
+		unsigned long probeDue = mProbeDue(now);
+		if ((long)(probeDue - due) < 0)
+			due = probeDue;
+	}
+	return due;
+}
+
+template<class Transport, class Profile>
+bool Line6Fbv<Transport, Profile>::mQueueFrame(const byte* inFrame, uint8_t inLength){
+	// updateUI() only queues what fits into the transport,
+	// so only requests without an updateUI() in between can get here with a full buffer
+	if (mTxLength + inLength > LINE6FBV_TX_BUFFER_SIZE){
+		mTxDropped++;
+		return false;
+	}
+	memcpy(&mTxBuffer[mTxLength], inFrame, inLength);
+	mTxLength += inLength;
+	return true;
+}
+
+// queue the LEDs of inMask that differ from the FBV, as long as there is space
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mSendLeds(int& ioSpace, uint32_t inMask){
+
+	// the FBV already shows this state
+	// or doesn't have the LED
+	uint32_t unchanged = mLedDirtyMask & ((mLedKnownMask & ~(mLedShownMask ^ mLedOnMask)) | ~mBoardLedSlots);
+	mSuppressedFrames += mCountBits(unchanged);
+	mLedDirtyMask &= ~unchanged;
+
+	uint32_t dirty = mLedDirtyMask & inMask;
+	for (uint8_t i = 1; i < Profile::numKeys && (dirty >> i) && ioSpace >= 5; i++){
+		uint32_t bit = mSlotBit(i);
+		if (!(dirty & bit))
+			continue;
+		byte onOff = (mLedOnMask & bit) ? 0x01 : 0x00;
+		//Serial.print("LED On/Off  : ");
+		//Serial.println(Profile::codeOfSlot(i), HEX);
+		byte frame[] = { 0xF0, 0x03, 0x04, Profile::codeOfSlot(i), onOff };
+		mQueueFrame(frame, sizeof(frame));
+		ioSpace -= sizeof(frame);
+
+		mLedKnownMask |= bit;
+		mLedShownMask = (mLedShownMask & ~bit) | (mLedOnMask & bit);
+		mLedDirtyMask &= ~bit;
+	}
+}
+
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::getSuppressedFrames(){
+	return mSuppressedFrames;
+}
+
+// write the queued frames that fit into ioSpace, whole frames only
+// frames not written stay in the buffer for the next call
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mFlushTx(int& ioSpace){
+	uint8_t length = 0;
+	uint8_t frames = 0;
+	while (length < mTxLength){
+		uint8_t frameLength = mTxBuffer[length + 1] + 2;   // F0 <len> <len bytes>
+		if (length + frameLength > ioSpace)
+			break;
+		length += frameLength;
+		frames++;
+	}
+	if (length){
+		mTransport.write(mTxBuffer, length);
+		mTxBytes += length;
+		mTxFrames += frames;
+		ioSpace -= length;
+		mTxLength -= length;
+		memmove(mTxBuffer, &mTxBuffer[length], mTxLength);
+		// a probe is only queued into an empty buffer, so it was the first frame
+		if (mProbePending == LINE6FBV_PROBE_QUEUED){
+			mProbePending = LINE6FBV_PROBE_SENT;
+			mProbeSince = millis();
+		}
+	}
+}
+
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::getTxDeferrals(){
+	return mTxDeferrals;
+}
+
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::getTxBlockedTime(){
+	return mTxBlockedTime;
+}
+
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::getTxMaxBlockedTime(){
+	return mTxMaxBlockedTime;
+}
+
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::getTxDropped(){
+	return mTxDropped;
+}
+
+template<class Transport, class Profile>
+unsigned int Line6Fbv<Transport, Profile>::getTxBytes(){
+	return mLastTxBytes;
+}
+
+template<class Transport, class Profile>
+byte Line6Fbv<Transport, Profile>::getTxFrames(){
+	return mLastTxFrames;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::read() {
+	decode();
+	dispatchEvents();
+}
+
+// producer side of the event queue: assemble frames from the incoming bytes
+// nothing else is touched here, so a slow callback never delays decoding
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::decode() {
+	while (mTransport.available() > 0) {
+		decodeByte(mTransport.read());
+	}
+}
+
+// the frame state machine, one byte at a time
+// F0 <length> <length bytes>: the length byte decides where the frame ends,
+// 0xF0 only starts frames, so it always starts a new one
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::decodeByte(byte inByte) {
+	if (inByte == 0xF0) {
+		if (mByteCount)
+			mRxMalformed++;   // the frame before is incomplete
+		mDataBytes[0] = inByte;
+		mByteCount = 1;
+		mBytesExpected = 0;
+		mRxSkipping = 0;
+		return;
+	}
+
+	if (!mByteCount) {
+		// outside a frame, count each run of skipped bytes once
+		if (!mRxSkipping) {
+			mRxSkipping = 1;
+			mRxResyncs++;
+		}
+		return;
+	}
+
+	if (mByteCount == 1) {
+		// data bytes are 7 bit, a frame has at least the opcode
+		if (!inByte || (inByte & 0x80)) {
+			mRxMalformed++;
+			mByteCount = 0;
+			return;
+		}
+		mBytesExpected = inByte + 2;
+	}
+
+	if (mByteCount < sizeof(mDataBytes))
+		mDataBytes[mByteCount] = inByte;
+	mByteCount++;
+
+	if (mByteCount == mBytesExpected) {
+		mByteCount = 0;
+		mFrameDecoded();
+	}
+}
+
+// a complete frame: look up the opcode, queue the known ones
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mFrameDecoded() {
+	byte length = mDataBytes[1];
+	byte opcode = mDataBytes[2];
+
+	for (uint8_t i = 0; i < sizeof(line6FbvFrameTypes) / sizeof(line6FbvFrameTypes[0]); i++) {
+		if (pgm_read_byte(&line6FbvFrameTypes[i].opcode) != opcode)
+			continue;
+		if (pgm_read_byte(&line6FbvFrameTypes[i].length) != length) {
+			mRxMalformed++;
+			return;
+		}
+		mPushEvent(length, opcode, mDataBytes[3], length == 0x03 ? mDataBytes[4] : 0);
+		return;
+	}
+	mRxUnknown++;
+}
+
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::getRxMalformed() {
+	return mRxMalformed;
+}
+
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::getRxUnknown() {
+	return mRxUnknown;
+}
+
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::getRxResyncs() {
+	return mRxResyncs;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mPushEvent(byte inLength, byte inOpcode, byte inData1, byte inData2) {
+	uint8_t head = mEventHead;
+	uint8_t next = (head + 1) & (LINE6FBV_EVENT_QUEUE_SIZE - 1);
+	if (next == mEventTail){
+		mEventOverflows++;   // the oldest events are kept, this one is lost
+		return;
+	}
+	Line6FbvEvent& event = mEvents[head];
+	event.length = inLength;
+	event.opcode = inOpcode;
+	event.data[0] = inData1;
+	event.data[1] = inData2;
+	event.arrival = micros();
+	LINE6FBV_MEMORY_BARRIER();   // the event is complete before the consumer can see it
+	mEventHead = next;
+}
+
+// consumer side of the event queue
+template<class Transport, class Profile>
+bool Line6Fbv<Transport, Profile>::popEvent(Line6FbvEvent& outEvent) {
+	uint8_t tail = mEventTail;
+	if (tail == mEventHead)
+		return false;
+	LINE6FBV_MEMORY_BARRIER();
+	outEvent = mEvents[tail];
+	LINE6FBV_MEMORY_BARRIER();   // copied before the producer may reuse the entry
+	mEventTail = (tail + 1) & (LINE6FBV_EVENT_QUEUE_SIZE - 1);
+	return true;
+}
+
+template<class Transport, class Profile>
+uint8_t Line6Fbv<Transport, Profile>::getPendingEvents() {
+	return (mEventHead - mEventTail) & (LINE6FBV_EVENT_QUEUE_SIZE - 1);
+}
+
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::getEventOverflows() {
+	return mEventOverflows;
+}
+
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::getEventArrival() {
+	return mEventArrival;
+}
+
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::getMaxEventLatency() {
+	return mMaxEventLatency;
+}
+
+// fire the callbacks for all decoded frames
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::dispatchEvents() {
+
+	Line6FbvEvent event;
+
+	while (popEvent(event)) {
+		// millis() of the arrival, from the age of the event
+		unsigned long age = micros() - event.arrival;
+		unsigned long eventMillis = millis() - age / 1000;
+		if (age > mMaxEventLatency)
+			mMaxEventLatency = age;
+		mEventArrival = event.arrival;
+
+		if (!mConnected)
+			mStartResync(eventMillis);
+		mConnected = true;   // connection established
+		mLastConnectionCheck = eventMillis;
+		// any frame answers the probe
+		mProbeMisses = 0;
+		if (mProbePending){
+			mProbePending = 0;
+			if (mProbeWait < LINE6FBV_PROBE_BACKOFF * mProbeInterval)
+				mProbeWait *= 2;
+		}
+
+		// the decoder checked the length of each opcode (line6FbvFrameTypes)
+		switch (event.opcode) {
+		case 0x90:   // Heartbeat part 1, the callback fires with part 2
+			break;
+		case 0x30:   // Heartbeat part 2
+			if (mCbHeartbeat) {
+				mCbHeartbeat();
+			}
+			break;
+		case 0x82:
+			if (event.data[0] < 2){
+				// answers to probes and requests report both pedals, mostly unchanged
+				if (mPedalValue[event.data[0]] == event.data[1])
+					break;
+				mPedalValue[event.data[0]] = event.data[1];
+			}
+			mProbeWait = mProbeInterval;   // only a pedal that moved
+			if (mCbCtrlChanged) {
+				mCbCtrlChanged(event.data[0], event.data[1]);
+			}
+			break;
+		case 0x81:
+			mProbeWait = mProbeInterval;
+			if (event.data[1] == 0x00) {
+				byte held = mStopHold(event.data[0]);
+				// a chord reports no release
+				if (!mGestureRelease(mGetLedInArray(event.data[0])) && mCbKeyReleased)
+					mCbKeyReleased(Profile::keyOfSlot(mGetLedInArray(event.data[0])), held);
+			}
+
+			if (event.data[1] == 0x01) {
+				mStartHold(event.data[0], eventMillis);
+				// a key of a chord reports its press later
+				if (!mGesturePress(mGetLedInArray(event.data[0])) && mCbKeyPressed)
+					mCbKeyPressed(Profile::keyOfSlot(mGetLedInArray(event.data[0])));
+			}
+		}
+	}
+
+	if (mConnected) {
+		if (millis() - mLastConnectionCheck > LINE6FBV_CONNECTION_LOST_TIME){
+			mLinkLost();
+		}
+		else if (mProbeInterval){
+			mCheckProbe();
+		}
+	}
+	else if (mOffline && mProbeInterval){
+		mCheckProbe();
+	}
+
+	mCheckHold();   // check elapsed time for "hold" state
+}
+
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setDisplayTitle(char* inTitle){
+
+	char title[16];
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_MARQUEE)
+	// long titles scroll, trailing spaces don't count
+	uint8_t length = 0;
+	if (mMarqueeStepTime){
+		while (length < LINE6FBV_MAX_TITLE_LENGTH && inTitle[length])
+			length++;
+		while (length > 16 && inTitle[length - 1] == ' ')
+			length--;
+	}
+	if (length > 16){
+		if (length == mLongTitleLength && !memcmp(mLongTitle, inTitle, length))
+			return;   // already scrolling
+		memcpy(mLongTitle, inTitle, length);
+		mLongTitleLength = length;
+		mMarqueePos = 0;
+		mMarqueeDue = millis() + mMarqueePauseTime;
+		mScheduleUi(mMarqueeDue);
+	}
+	else{
+		mLongTitleLength = 0;
+	}
+#endif
+
+	mDisplayDirty |= LINE6FBV_SEG_TITLE;
+
+	strncpy(title, inTitle, 16);
+
+	for (int i = 0; i < 16; i++){
+		mDisplay.title[i] = title[i];
+	}
+}
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_MARQUEE)
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setDisplayMarquee(int inStepTime, int inPauseTime, int inBytesPerSecond){
+	mMarqueeStepTime = inStepTime;
+	mMarqueePauseTime = inPauseTime;
+	mMarqueeBytesPerSecond = inBytesPerSecond > 0 ? inBytesPerSecond : 1;
+	if (!inStepTime && mLongTitleLength){
+		// show the start of the title again
+		mLongTitleLength = 0;
+		memcpy(mDisplay.title, mLongTitle, 16);
+		mDisplayDirty |= LINE6FBV_SEG_TITLE;
+	}
+}
+#endif
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setDisplayDigit(int inNum, char inDigit){
+	mDisplayDirty |= (1 << inNum);
+
+	if (inNum < 3)
+		mDisplay.numDigits[inNum] = inDigit;
+	else
+		mDisplay.noteDigit = inDigit;
+
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setDisplayDigits(char* inDigits){
+
+	char digits[4];
+
+	mDisplayDirty |= LINE6FBV_SEG_DIGITS;
+
+	strncpy(digits, inDigits, 4);
+	
+
+	for (int i = 0; i < 3; i++){
+		mDisplay.numDigits[i] = digits[i];
+	}
+	mDisplay.noteDigit = digits[3];
+
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setDisplayNumber(int inNumber){
+	char digits[3];
+
+	mNumberToDigits(inNumber, digits);
+
+	setDisplayDigit(0, digits[0]);
+	setDisplayDigit(1, digits[1]);
+	setDisplayDigit(2, digits[2]);
+}
+
+// the first 3 digits for a number, without leading zeros
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mNumberToDigits(int inNumber, char* outDigits){
+	int number;
+	byte digit_100;
+	byte digit_10;
+	byte digit_1;
+
+	number = inNumber % 1000; // only 3 digits possible
+
+	digit_100 = number / 100;
+	number = number % 100;
+	digit_10 = number / 10;
+	digit_1 = number % 10;
+
+	// char value for int
+	digit_100 += 0x30;
+	digit_10 += 0x30;
+	digit_1 += 0x30;
+
+	// suppress leading zero
+	if (digit_100 == 0x30){
+		digit_100 = 0x20;
+		if (digit_10 == 0x30){
+			digit_10 = 0x20;
+		}
+	}
+
+	outDigits[0] = digit_100;
+	outDigits[1] = digit_10;
+	outDigits[2] = digit_1;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mBlankDisplay(Display& outDisplay){
+	outDisplay.numDigits[0] = 0x20;
+	outDisplay.numDigits[1] = 0x20;
+	outDisplay.numDigits[2] = 0x20;
+	outDisplay.noteDigit = 0x20;
+	outDisplay.flat = 0;
+	for (int i = 0; i < 16; i++){
+		outDisplay.title[i] = 0x20;
+	}
+}
+
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setDisplayFlat(byte inOnOff){
+	mDisplayDirty |= LINE6FBV_SEG_FLAT;
+	mDisplay.flat = inOnOff;
+}
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_DISPLAY_FLASH)
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setDisplayFlash(int inOnTime, int inOffTime){
+	if (inOnTime != 0){
+	mDisplay.flash = 1;
+	mDisplay.onTime = inOnTime;
+	mDisplay.offTime = inOffTime;
+	mDisplay.due = millis();
+	mScheduleUi(mDisplay.due);
+	}
+	else{
+		mDisplay.flash = 0;
+		}
+	}
+#endif
+
+
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_OVERLAYS)
+// an overlay layer covers inSegments from now on, inTime 0 = until cleared
+template<class Transport, class Profile>
+typename Line6Fbv<Transport, Profile>::Overlay* Line6Fbv<Transport, Profile>::mUseOverlay(byte inLayer, byte inSegments, unsigned int inTime){
+	if (inLayer >= LINE6FBV_NUM_OVERLAYS)
+		return 0;
+
+	Overlay* overlay = &mOverlays[inLayer];
+	overlay->segments |= inSegments;
+	overlay->timed = inTime != 0;
+	if (inTime){
+		overlay->until = millis() + inTime;
+		mScheduleUi(overlay->until);
+	}
+	mOverlaySegments |= inSegments;
+	mDisplayDirty |= inSegments;
+	return overlay;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setOverlayTitle(byte inLayer, char* inTitle, unsigned int inTime){
+	Overlay* overlay = mUseOverlay(inLayer, LINE6FBV_SEG_TITLE, inTime);
+	if (overlay)
+		strncpy(overlay->title, inTitle, 16);
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setOverlayDigit(byte inLayer, int inNumDigit, char inDigit, unsigned int inTime){
+	if (inNumDigit < 0 || inNumDigit > 3)
+		return;
+	Overlay* overlay = mUseOverlay(inLayer, 1 << inNumDigit, inTime);
+	if (overlay)
+		overlay->digits[inNumDigit] = inDigit;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setOverlayDigits(byte inLayer, char* inDigits, unsigned int inTime){
+	Overlay* overlay = mUseOverlay(inLayer, LINE6FBV_SEG_DIGITS, inTime);
+	if (overlay)
+		strncpy(overlay->digits, inDigits, 4);
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setOverlayNumber(byte inLayer, int inNumber, unsigned int inTime){
+	Overlay* overlay = mUseOverlay(inLayer, 0x07, inTime);   // digits 0-2
+	if (overlay)
+		mNumberToDigits(inNumber, overlay->digits);
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setOverlayFlat(byte inLayer, byte inOnOff, unsigned int inTime){
+	Overlay* overlay = mUseOverlay(inLayer, LINE6FBV_SEG_FLAT, inTime);
+	if (overlay)
+		overlay->flat = inOnOff;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::clearDisplayOverlay(byte inLayer){
+	if (inLayer >= LINE6FBV_NUM_OVERLAYS || !mOverlays[inLayer].segments)
+		return;
+	// compare what was covered against the layers below
+	mDisplayDirty |= mOverlays[inLayer].segments;
+	mOverlays[inLayer].segments = 0;
+	mUpdateOverlaySegments();
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mUpdateOverlaySegments(){
+	mOverlaySegments = 0;
+	for (uint8_t l = 0; l < LINE6FBV_NUM_OVERLAYS; l++){
+		mOverlaySegments |= mOverlays[l].segments;
+	}
+}
+
+// the display with all overlays on top, lowest layer first
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mComposeDisplay(Display& outDisplay){
+	outDisplay = mDisplay;
+	for (uint8_t l = 0; l < LINE6FBV_NUM_OVERLAYS; l++){
+		const Overlay& overlay = mOverlays[l];
+		if (!overlay.segments)
+			continue;
+		for (uint8_t i = 0; i < 3; i++){
+			if (overlay.segments & (1 << i))
+				outDisplay.numDigits[i] = overlay.digits[i];
+		}
+		if (overlay.segments & 0x08)
+			outDisplay.noteDigit = overlay.digits[3];
+		if (overlay.segments & LINE6FBV_SEG_FLAT)
+			outDisplay.flat = overlay.flat;
+		if (overlay.segments & LINE6FBV_SEG_TITLE)
+			memcpy(outDisplay.title, overlay.title, 16);
+	}
+}
+#endif
+
+// send the segments marked in mDisplayDirty, if they differ from what the FBV shows
+// segments that don't fit into ioSpace stay dirty for the next call
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::sendDisplayData(const Display& inDisplay, int& ioSpace){
+	/* clear display title
+	F0 01 11
+	*/
+
+	char digits[4] = { inDisplay.numDigits[0], inDisplay.numDigits[1], inDisplay.numDigits[2], inDisplay.noteDigit };
+	uint8_t numChanged = 0;
+	uint8_t lastChanged = 0;
+
+	for (uint8_t i = 0; i < 4; i++){
+		if (!(mDisplayDirty & (1 << i)))
+			continue;
+		if (!(mShownKnown & (1 << i)) || digits[i] != mShownDigits[i]){
+			numChanged++;
+			lastChanged = i;
+		}
+		else{
+			mDisplayDirty &= ~(1 << i);   // already shown
+		}
+	}
+
+	if (numChanged == 1 && (lastChanged == 3 || digits[lastChanged] == ' '
+		|| (digits[lastChanged] >= '0' && digits[lastChanged] <= '9'))){
+		// one digit: 4 bytes instead of 7
+		// the first three must be numeric or space
+		byte digit[] = { 0xF0, 0x02, lastChanged, (byte)digits[lastChanged] };
+		if (ioSpace >= (int)sizeof(digit)){
+			mQueueFrame(digit, sizeof(digit));
+			ioSpace -= sizeof(digit);
+			mShownDigits[lastChanged] = digits[lastChanged];
+			mShownKnown |= (1 << lastChanged);
+			mDisplayDirty &= ~(1 << lastChanged);
+		}
+	}
+	else if (numChanged){
+		// the first 4 digits together
+		byte block[] = { 0xF0, 0x05, 0x08, (byte)digits[0], (byte)digits[1], (byte)digits[2], (byte)digits[3] };
+		if (ioSpace >= (int)sizeof(block)){
+			mQueueFrame(block, sizeof(block));
+			ioSpace -= sizeof(block);
+			memcpy(mShownDigits, digits, 4);
+			mShownKnown |= LINE6FBV_SEG_DIGITS;
+			mDisplayDirty &= ~LINE6FBV_SEG_DIGITS;
+		}
+	}
+
+	// flat sign
+	if (mDisplayDirty & LINE6FBV_SEG_FLAT){
+		if ((mShownKnown & LINE6FBV_SEG_FLAT) && inDisplay.flat == mShownFlat){
+			mDisplayDirty &= ~LINE6FBV_SEG_FLAT;
+		}
+		else if (ioSpace >= 4){
+			byte flat[] = { 0xF0, 0x02, 0x20, inDisplay.flat };
+			mQueueFrame(flat, sizeof(flat));
+			ioSpace -= sizeof(flat);
+			mShownFlat = inDisplay.flat;
+			mShownKnown |= LINE6FBV_SEG_FLAT;
+			mDisplayDirty &= ~LINE6FBV_SEG_FLAT;
+		}
+	}
+
+	// title
+	if (mDisplayDirty & LINE6FBV_SEG_TITLE){
+		if ((mShownKnown & LINE6FBV_SEG_TITLE) && !memcmp(inDisplay.title, mShownTitle, 16)){
+			mDisplayDirty &= ~LINE6FBV_SEG_TITLE;
+		}
+		else if (ioSpace >= 21){
+			byte title[21] = { 0xF0, 0x13, 0x10, 0x00, 0x10 };
+			memcpy(&title[5], inDisplay.title, 16);
+			mQueueFrame(title, sizeof(title));
+			ioSpace -= sizeof(title);
+			memcpy(mShownTitle, inDisplay.title, 16);
+			mShownKnown |= LINE6FBV_SEG_TITLE;
+			mDisplayDirty &= ~LINE6FBV_SEG_TITLE;
+		}
+	}
+}
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_HOLD)
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mStartHold(byte inKey, unsigned long inTime){
+	// Find the Switch in the array and set the value
+	uint8_t i = mGetLedInArray(inKey);
+
+	mHeldMask &= ~mSlotBit(i);
+	mPressedMask |= mSlotBit(i);
+	mPressTime[i] = inTime;   // when the frame arrived
+
+	if (i && mHoldTime[i]){
+		mScheduleKeyTimer(mPressTime[i] + mHoldTime[i]);
+		mHoldMask |= mSlotBit(i);
+	}
+};
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mScheduleKeyTimer(unsigned long inDue){
+	if (!mKeyTimersArmed() || (long)(inDue - mNextHoldDue) < 0)
+		mNextHoldDue = inDue;
+}
+
+// keys waiting for the hold time or a gesture deadline
+template<class Transport, class Profile>
+bool Line6Fbv<Transport, Profile>::mKeyTimersArmed(){
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_GESTURES)
+	if (mGestureArmed)
+		return true;
+#endif
+	return mHoldMask != 0;
+}
+
+
+// called when key is released, returns hold state, so the hold information needs not to be stored in the calling application
+template<class Transport, class Profile>
+byte Line6Fbv<Transport, Profile>::mStopHold(byte inKey){
+
+	byte retVal = 0;
+	uint8_t i = mGetLedInArray(inKey);
+
+	// Find the Switch in the array and set the value
+			retVal = (mHeldMask & mSlotBit(i)) ? 1 : 0;
+			mHeldMask &= ~mSlotBit(i);
+			mPressedMask &= ~mSlotBit(i);
+			mHoldMask &= ~mSlotBit(i);
+	return retVal;
+};
+
+
+
+
+// check if hold time is elapsed while key is pressed
+// only keys in mHoldMask and armed gestures are checked, and only when the earliest of them is due
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mCheckHold(){
+
+	if (!mKeyTimersArmed())
+		return;
+
+	unsigned long currentMillis = millis();
+	if ((long)(currentMillis - mNextHoldDue) < 0)
+		return;
+
+	mNextHoldDue = currentMillis + LINE6FBV_MAX_SLEEP;
+	uint32_t waiting = mHoldMask;
+	for (uint8_t i = 1; i < Profile::numKeys && (waiting >> i); i++){
+		if (!(waiting & mSlotBit(i)))
+			continue;
+		unsigned long due = mPressTime[i] + mHoldTime[i];
+		if ((long)(currentMillis - due) >= 0) {
+			mHoldMask &= ~mSlotBit(i);
+			if (mCbKeyHeld){
+				mHeldMask |= mSlotBit(i);
+				mCbKeyHeld(Profile::keyOfSlot(i));
+			}
+		}
+		else if ((long)(due - mNextHoldDue) < 0){
+			mNextHoldDue = due;
+		}
+	}
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_GESTURES)
+	uint8_t armed = mGestureArmed;
+	for (uint8_t g = 0; g < LINE6FBV_NUM_GESTURE_KEYS; g++){
+		if (armed & (1 << g))
+			mGestureTimer(g, currentMillis);
+	}
+#endif
+
+};
+#endif
+
+#if LINE6FBV_HAS(LINE6FBV_FEATURE_GESTURES)
+
+template<class Transport, class Profile>
+typename Line6Fbv<Transport, Profile>::KeyGesture* Line6Fbv<Transport, Profile>::mGestureOf(uint8_t inSlot, bool inCreate){
+	if (!inSlot)
+		return 0;
+	KeyGesture* unused = 0;
+	for (uint8_t g = 0; g < LINE6FBV_NUM_GESTURE_KEYS; g++){
+		if (mGestures[g].slot == inSlot)
+			return &mGestures[g];
+		if (!mGestures[g].slot && !unused)
+			unused = &mGestures[g];
+	}
+	if (!inCreate || !unused)
+		return 0;
+
+	memset(unused, 0, sizeof(KeyGesture));
+	unused->slot = inSlot;
+	return unused;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setDoubleTap(byte inKey, unsigned int inTime){
+	KeyGesture* gesture = mGestureOf(Profile::slotOfKey(inKey), true);
+	if (gesture)
+		gesture->doubleTapTime = inTime;
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setHoldTiers(byte inKey, unsigned int inTier1, unsigned int inTier2, unsigned int inTier3){
+	KeyGesture* gesture = mGestureOf(Profile::slotOfKey(inKey), true);
+	if (gesture){
+		gesture->holdTiers[0] = inTier1;
+		gesture->holdTiers[1] = inTier2;
+		gesture->holdTiers[2] = inTier3;
+	}
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setAutoRepeat(byte inKey, unsigned int inDelay, unsigned int inInterval){
+	KeyGesture* gesture = mGestureOf(Profile::slotOfKey(inKey), true);
+	if (gesture){
+		gesture->repeatDelay = inDelay;
+		gesture->repeatInterval = inInterval;
+	}
+}
+
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::setChord(byte inKey1, byte inKey2){
+	uint8_t slot1 = Profile::slotOfKey(inKey1);
+	uint8_t slot2 = Profile::slotOfKey(inKey2);
+	if (!slot1 || !slot2 || slot1 == slot2)
+		return;
+	KeyGesture* gesture1 = mGestureOf(slot1, true);
+	KeyGesture* gesture2 = mGestureOf(slot2, true);
+	if (gesture1 && gesture2){
+		gesture1->chordSlot = slot2;
+		gesture2->chordSlot = slot1;
+	}
+}
+
+// a key is pressed, returns true if the press must not be reported now
+template<class Transport, class Profile>
+bool Line6Fbv<Transport, Profile>::mGesturePress(uint8_t inSlot){
+	KeyGesture* gesture = mGestureOf(inSlot, false);
+	if (!gesture)
+		return false;
+
+	unsigned long pressTime = mPressTime[inSlot];
+	uint8_t index = gesture - mGestures;
+	gesture->nextTier = 0;
+	gesture->repeatCount = 0;
+	gesture->state = 0;
+
+	if (gesture->chordSlot){
+		KeyGesture* other = mGestureOf(gesture->chordSlot, false);
+		if (other && (other->state & LINE6FBV_GST_WAIT_CHORD)
+			&& pressTime - mPressTime[other->slot] > LINE6FBV_CHORD_TIME){
+			// the chord time ran out before the timer ran, report the other press late
+			other->state &= ~LINE6FBV_GST_WAIT_CHORD;
+			if (mCbKeyPressed)
+				mCbKeyPressed(Profile::keyOfSlot(other->slot));
+		}
+		else if (other && (other->state & LINE6FBV_GST_WAIT_CHORD)){
+			// the other key was pressed just before
+			other->state = LINE6FBV_GST_CHORD;
+			gesture->state = LINE6FBV_GST_CHORD;
+			mGestureArmed &= ~(1 << (other - mGestures));
+			if (mCbGesture)
+				mCbGesture(Profile::keyOfSlot(other->slot), LINE6FBV_GESTURE_CHORD, Profile::keyOfSlot(inSlot));
+			return true;
+		}
+		gesture->state = LINE6FBV_GST_WAIT_CHORD;
+	}
+
+	if (gesture->doubleTapTime){
+		if (gesture->lastTap && pressTime - gesture->lastTap <= gesture->doubleTapTime){
+			gesture->lastTap = 0;
+			if (mCbGesture)
+				mCbGesture(Profile::keyOfSlot(inSlot), LINE6FBV_GESTURE_DOUBLE_TAP, 2);
+		}
+		else{
+			gesture->lastTap = pressTime ? pressTime : 1;
+		}
+	}
+
+	bool armed;
+	unsigned long due = mGestureDue(*gesture, armed);
+	if (armed){
+		mScheduleKeyTimer(due);
+		mGestureArmed |= (1 << index);
+	}
+	return gesture->state & LINE6FBV_GST_WAIT_CHORD;
+}
+
+// a key is released, returns true if the release must not be reported
+template<class Transport, class Profile>
+bool Line6Fbv<Transport, Profile>::mGestureRelease(uint8_t inSlot){
+	KeyGesture* gesture = mGestureOf(inSlot, false);
+	if (!gesture)
+		return false;
+
+	mGestureArmed &= ~(1 << (gesture - mGestures));
+	uint8_t state = gesture->state;
+	gesture->state = 0;
+
+	if (state & LINE6FBV_GST_WAIT_CHORD){
+		// released before the chord time was over: a short single press
+		if (mCbKeyPressed)
+			mCbKeyPressed(Profile::keyOfSlot(inSlot));
+	}
+	return state & LINE6FBV_GST_CHORD;
+}
+
+// next deadline of a pressed key, outArmed is false if there is none
+template<class Transport, class Profile>
+unsigned long Line6Fbv<Transport, Profile>::mGestureDue(const KeyGesture& inGesture, bool& outArmed){
+	unsigned long pressTime = mPressTime[inGesture.slot];
+	unsigned long offset = 0xFFFFFFFF;
+
+	if (inGesture.state & LINE6FBV_GST_WAIT_CHORD)
+		offset = LINE6FBV_CHORD_TIME;
+	if (inGesture.nextTier < LINE6FBV_HOLD_TIERS && inGesture.holdTiers[inGesture.nextTier]
+		&& inGesture.holdTiers[inGesture.nextTier] < offset)
+		offset = inGesture.holdTiers[inGesture.nextTier];
+	if (inGesture.repeatInterval && inGesture.repeatCount < 255){
+		unsigned long repeat = inGesture.repeatDelay + (unsigned long)inGesture.repeatCount * inGesture.repeatInterval;
+		if (repeat < offset)
+			offset = repeat;
+	}
+
+	outArmed = offset != 0xFFFFFFFF;
+	return pressTime + offset;
+}
+
+// deadlines of one pressed key: end of the chord time, hold tiers, auto repeat
+template<class Transport, class Profile>
+void Line6Fbv<Transport, Profile>::mGestureTimer(uint8_t inIndex, unsigned long inNow){
+	KeyGesture& gesture = mGestures[inIndex];
+	unsigned long elapsed = inNow - mPressTime[gesture.slot];
+	byte key = Profile::keyOfSlot(gesture.slot);
+
+	if ((gesture.state & LINE6FBV_GST_WAIT_CHORD) && elapsed >= LINE6FBV_CHORD_TIME){
+		// no chord, report the press late
+		gesture.state &= ~LINE6FBV_GST_WAIT_CHORD;
+		if (mCbKeyPressed)
+			mCbKeyPressed(key);
+	}
+
+	while (gesture.nextTier < LINE6FBV_HOLD_TIERS && gesture.holdTiers[gesture.nextTier]
+		&& elapsed >= gesture.holdTiers[gesture.nextTier]){
+		gesture.nextTier++;
+		if (mCbGesture)
+			mCbGesture(key, LINE6FBV_GESTURE_HOLD, gesture.nextTier);
+	}
+
+	if (gesture.repeatInterval && gesture.repeatCount < 255
+		&& elapsed >= gesture.repeatDelay + (unsigned long)gesture.repeatCount * gesture.repeatInterval){
+		gesture.repeatCount++;
+		if (mCbGesture)
+			mCbGesture(key, LINE6FBV_GESTURE_REPEAT, gesture.repeatCount);
+	}
+
+	bool armed;
+	unsigned long due = mGestureDue(gesture, armed);
+	if (!armed){
+		mGestureArmed &= ~(1 << inIndex);
+	}
+	else if ((long)(due - mNextHoldDue) < 0){
+		mNextHoldDue = due;
+	}
+}
+#endif
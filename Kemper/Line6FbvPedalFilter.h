@@ -0,0 +1,222 @@
+/*!
+*  @file       Line6FbvPedalFilter.h
+*  Project     Arduino Line6 FBV Longboard to MIDI Library
+*  @brief      filter for the pedal positions of the FBV
+*  @author     Joachim Wrba
+*  @license    GPL v3.0
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The FBV reports every step of a pedal, a full sweep gives 127 positions and
+a pedal at rest may jitter by one step. One filter per pedal sits between the
+ctrl changed callback and the MIDI output:
+
+	if (filter.filter(inValue))
+		sendControlChange(filter.getValue());
+
+and in loop():
+
+	if (filter.update())
+		sendControlChange(filter.getValue());
+
+Positions held back by the interval or the rate are sent by update(). A small
+last move swallowed by the dead-band or the hysteresis is sent by update() once
+the pedal rested for LINE6FBV_PEDAL_SETTLE_TIME, so the position the pedal stops
+at always arrives.
+It doesn't depend on Line6Fbv.h, any sketch can use it.
+*/
+
+#ifndef LINE6FBV_PEDAL_FILTER_H
+#define LINE6FBV_PEDAL_FILTER_H
+
+#include <Arduino.h>
+
+// default settings
+#define LINE6FBV_PEDAL_DEAD_BAND  1      // steps around the last value ignored while the pedal rests
+#define LINE6FBV_PEDAL_HYSTERESIS  2     // steps the pedal must move back against its direction
+#define LINE6FBV_PEDAL_MIN_INTERVAL  5   // ms between two values
+#define LINE6FBV_PEDAL_MAX_RATE  50      // values per second, 0 = no limit
+#define LINE6FBV_PEDAL_SETTLE_TIME  250  // ms without a report, then the pedal rests
+
+#define LINE6FBV_PEDAL_MAX  127          // the end positions 0 and 127 always pass
+#define LINE6FBV_PEDAL_NONE  0xFF        // no value sent yet
+
+
+class Line6FbvPedalFilter {
+public:
+
+	Line6FbvPedalFilter();
+
+	void setFilter(byte inDeadBand, byte inHysteresis, unsigned int inMinInterval, unsigned int inMaxRate);
+
+	// a position reported by the FBV, true: send getValue() now
+	bool filter(byte inValue);
+
+	// call in loop(), true: a held back position is due, send getValue() now
+	bool update();
+
+	// the position to send
+	byte getValue();
+
+	// the position was sent without the filter, e.g. after a new pedal assignment
+	void reset(byte inValue);
+
+	// positions reported and sent, the difference was saved
+	unsigned long getReceived();
+	unsigned long getSent();
+
+private:
+
+	byte mDeadBand;
+	byte mHysteresis;
+	unsigned int mMinInterval;
+	unsigned int mMaxRate;
+
+	byte mSent;          // last position sent, LINE6FBV_PEDAL_NONE
+	byte mTarget;        // last position that passed dead-band and hysteresis
+	byte mRaw;           // last position reported, sent when the pedal rests
+	int8_t mDirection;   // of the last change that passed, 0 = resting
+	unsigned long mLastReport;
+	unsigned long mLastSent;
+	unsigned long mCredit;       // values * 1000 that may be sent
+	unsigned long mCreditTime;
+	unsigned long mReceived;
+	unsigned long mSentCount;
+
+	bool mPass(byte inValue);
+	bool mMaySend(unsigned long inNow);
+	void mSend(unsigned long inNow);
+};
+
+
+inline Line6FbvPedalFilter::Line6FbvPedalFilter() {
+	setFilter(LINE6FBV_PEDAL_DEAD_BAND, LINE6FBV_PEDAL_HYSTERESIS, LINE6FBV_PEDAL_MIN_INTERVAL, LINE6FBV_PEDAL_MAX_RATE);
+	mSent = LINE6FBV_PEDAL_NONE;
+	mTarget = LINE6FBV_PEDAL_NONE;
+	mRaw = LINE6FBV_PEDAL_NONE;
+	mDirection = 0;
+	mLastReport = 0;
+	mLastSent = 0;
+	mCredit = 0;
+	mCreditTime = 0;
+	mReceived = 0;
+	mSentCount = 0;
+}
+
+inline void Line6FbvPedalFilter::setFilter(byte inDeadBand, byte inHysteresis, unsigned int inMinInterval, unsigned int inMaxRate) {
+	mDeadBand = inDeadBand;
+	mHysteresis = inHysteresis;
+	mMinInterval = inMinInterval;
+	mMaxRate = inMaxRate;
+}
+
+inline bool Line6FbvPedalFilter::filter(byte inValue) {
+	unsigned long now = millis();
+	mReceived++;
+	if (now - mLastReport > LINE6FBV_PEDAL_SETTLE_TIME)
+		mDirection = 0;
+	mLastReport = now;
+	mRaw = inValue;
+
+	if (!mPass(inValue))
+		return false;
+	if (mTarget != LINE6FBV_PEDAL_NONE)
+		mDirection = inValue > mTarget ? 1 : -1;
+	mTarget = inValue;
+
+	if (mTarget == mSent || !mMaySend(now))
+		return false;   // back where it was, or held back for update()
+	mSend(now);
+	return true;
+}
+
+inline bool Line6FbvPedalFilter::update() {
+	unsigned long now = millis();
+	// resting: the last position, also a step inside the dead-band or the hysteresis
+	if (mRaw != mTarget && now - mLastReport >= LINE6FBV_PEDAL_SETTLE_TIME){
+		mTarget = mRaw;
+		mDirection = 0;
+	}
+	if (mTarget == mSent)
+		return false;
+	if (!mMaySend(now))
+		return false;
+	mSend(now);
+	return true;
+}
+
+inline byte Line6FbvPedalFilter::getValue() {
+	return mSent;
+}
+
+inline void Line6FbvPedalFilter::reset(byte inValue) {
+	mSent = inValue;
+	mTarget = inValue;
+	mRaw = inValue;
+	mDirection = 0;
+}
+
+inline unsigned long Line6FbvPedalFilter::getReceived() {
+	return mReceived;
+}
+
+inline unsigned long Line6FbvPedalFilter::getSent() {
+	return mSentCount;
+}
+
+// dead-band while resting, hysteresis against the direction of the movement
+inline bool Line6FbvPedalFilter::mPass(byte inValue) {
+	if (mTarget == LINE6FBV_PEDAL_NONE)
+		return true;   // the first position
+	if (inValue == mTarget)
+		return false;
+	if (inValue == 0 || inValue == LINE6FBV_PEDAL_MAX)
+		return true;
+
+	int8_t direction = inValue > mTarget ? 1 : -1;
+	byte distance = direction > 0 ? inValue - mTarget : mTarget - inValue;
+	if (!mDirection)
+		return distance > mDeadBand;
+	if (direction != mDirection)
+		return distance > mHysteresis;
+	return true;
+}
+
+// minimum interval, and the maximum rate as a credit of values like the marquee uses
+inline bool Line6FbvPedalFilter::mMaySend(unsigned long inNow) {
+	if (mSentCount && inNow - mLastSent < mMinInterval)
+		return false;
+	if (!mMaxRate)
+		return true;
+
+	// at most 2 values at once after a pause
+	unsigned long elapsed = inNow - mCreditTime;
+	mCreditTime = inNow;
+	if (elapsed > 2000)
+		elapsed = 2000;
+	mCredit += elapsed * mMaxRate;
+	if (mCredit > 2000)
+		mCredit = 2000;
+	return mCredit >= 1000;
+}
+
+inline void Line6FbvPedalFilter::mSend(unsigned long inNow) {
+	mSent = mTarget;
+	mLastSent = inNow;
+	if (mMaxRate)
+		mCredit -= 1000;
+	mSentCount++;
+}
+
+#endif
@@ -0,0 +1,156 @@
+/*!
+*  @file       Line6FbvBenchmark.ino
+*  Project     Arduino Line6 FBV Longboard to MIDI Library
+*  @brief      size and timing report for the Line6Fbv library
+*  @author     Joachim Wrba
+*  @license    GPL v3.0
+*
+*  No FBV needs to be connected, the results are printed to Serial (115200 baud).
+*  The scaling test decodes recorded frames for one and for two boards of the same profile,
+*  two boards should take about 200% of the time of one board. Both boards write to a sink
+*  that takes every byte, so a full serial port doesn't change the result.
+*
+*  The sketch only uses the basic functions, so it shows the size of each feature set:
+*  compiled with -DLINE6FBV_FEATURES=... (see extras/size-report.sh) it reports the
+*  SRAM per object, the flash and the global SRAM are in the compiler output.
+*/
+
+#include <Line6Fbv.h>
+
+// state of one switch / LED up to version 1.1, for comparison
+struct LegacyLedAndSwitch{
+	byte key;
+	int onTime;
+	int offTime;
+	int waitTime;
+	unsigned long lastMillis;
+	byte isOn;
+	byte setOn;
+	byte setOff;
+	byte flash;
+	int holdTime;
+	unsigned long lastPressTime;
+	byte isHeld;
+	byte isPressed;
+};
+
+// transport for the scaling test: nothing is received, every byte written is dropped
+class BenchmarkSink {
+public:
+	typedef Line6FbvNoPort PortType;
+
+	inline void begin(Line6FbvNoPort*){
+	}
+
+	inline void setReceiver(Line6FbvReceiveFunc*, void*){
+	}
+
+	inline int available(){
+		return 0;
+	}
+
+	inline byte read(){
+		return 0;
+	}
+
+	inline void write(byte){
+	}
+
+	inline void write(const byte*, size_t){
+	}
+
+	inline int availableForWrite(){
+		return LINE6FBV_TX_BUDGET;
+	}
+};
+
+Line6Fbv<> longboard;
+Line6Fbv<Line6FbvHardwareSerial, Line6FbvShortboard> shortboard;
+Line6Fbv<Line6FbvHardwareSerial, Line6FbvExpress> express;
+
+// the two boards of the scaling test
+Line6Fbv<BenchmarkSink> boardA;
+Line6Fbv<BenchmarkSink> boardB;
+
+#define BENCHMARK_ROUNDS 1000
+#define BENCHMARK_WARMUP 10   // the first frames connect the boards, the resync isn't measured
+
+// key press, pedal move and key release of one board, as received from the FBV
+const byte benchmarkFrames[] = {
+	0xF0, 0x03, 0x81, LINE6FBV_CC_STOMP1, 0x01,
+	0xF0, 0x03, 0x82, LINE6FBV_CC_PDL1, 0x40,
+	0xF0, 0x03, 0x81, LINE6FBV_CC_STOMP1, 0x00
+};
+
+void onBenchmarkKey(byte inKey){
+}
+
+// decode and dispatch the frames, then send the answer of the board
+template<class Fbv>
+void runBoard(Fbv& ioFbv, byte inLed){
+	for (byte i = 0; i < sizeof(benchmarkFrames); i++)
+		ioFbv.decodeByte(benchmarkFrames[i]);
+	ioFbv.dispatchEvents();
+	ioFbv.setLedOnOff(LINE6FBV_STOMP1, inLed);
+	ioFbv.updateUI();
+}
+
+// time per round in micros for one board and for two boards in one loop
+void reportScaling(){
+	for (int i = 0; i < BENCHMARK_WARMUP; i++){
+		runBoard(boardA, i & 1);
+		runBoard(boardB, i & 1);
+	}
+
+	unsigned long start = micros();
+	for (int i = 0; i < BENCHMARK_ROUNDS; i++){
+		runBoard(boardA, i & 1);
+	}
+	unsigned long one = (micros() - start) / BENCHMARK_ROUNDS;
+
+	start = micros();
+	for (int i = 0; i < BENCHMARK_ROUNDS; i++){
+		runBoard(boardA, i & 1);
+		runBoard(boardB, i & 1);
+	}
+	unsigned long two = (micros() - start) / BENCHMARK_ROUNDS;
+
+	Serial.print("one board: ");
+	Serial.print(one);
+	Serial.print(" us per round, two boards: ");
+	Serial.print(two);
+	Serial.print(" us per round, ");
+	Serial.print(one ? (two * 100) / one : 0);
+	Serial.println("% of one board");
+}
+
+// SRAM of one object of a profile, with the compiled feature set
+template<class Profile>
+void reportState(const char* inName){
+	Serial.print(inName);
+	Serial.print(sizeof(Line6Fbv<Line6FbvHardwareSerial, Profile>));
+	Serial.println(" bytes");
+}
+
+void setup() {
+	Serial.begin(115200);
+
+	Serial.print("Line6Fbv features 0x");
+	Serial.println(LINE6FBV_FEATURES, HEX);
+	Serial.println("Line6Fbv SRAM per object");
+	reportState<Line6FbvLongboard>("Longboard:  ");
+	reportState<Line6FbvShortboard>("Shortboard: ");
+	reportState<Line6FbvExpress>("Express:    ");
+	Serial.print("switch/LED state up to 1.1: ");
+	Serial.print(sizeof(LegacyLedAndSwitch) * LINE6FBV_NUM_LED_AND_SWITCH);
+	Serial.println(" bytes");
+
+	boardA.begin();
+	boardA.setHandleKeyPressed(&onBenchmarkKey);
+	boardB.begin();
+	boardB.setHandleKeyPressed(&onBenchmarkKey);
+	reportScaling();
+}
+
+void loop() {
+}
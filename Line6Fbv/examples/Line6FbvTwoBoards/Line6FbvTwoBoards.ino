@@ -0,0 +1,88 @@
+/*!
+*  @file       Line6FbvTwoBoards.ino
+*  Project     Arduino Line6 FBV Longboard to MIDI Library
+*  @brief      a Longboard and a Shortboard on one Arduino Mega
+*  @author     Joachim Wrba
+*  @license    GPL v3.0
+*
+*  The Longboard is connected to Serial1, the Shortboard to Serial2.
+*  Each object keeps its own connection, LED and display state, so one
+*  board can be switched off without disturbing the other one.
+*  Events are printed to Serial (115200 baud).
+*/
+
+#include <Line6Fbv.h>
+
+Line6Fbv<> longboard;
+Line6Fbv<Line6FbvHardwareSerial, Line6FbvShortboard> shortboard;
+
+char longTitle[] = "LONGBOARD";
+char shortTitle[] = "SHORTBOARD";
+
+// the callbacks have no context, so each board gets its own set
+void onLongKeyPressed(byte inKey){
+	Serial.print("Longboard key ");
+	Serial.println(inKey);
+	longboard.setLedOnOff(inKey, 1);
+}
+
+void onLongKeyReleased(byte inKey, byte inHeld){
+	longboard.setLedOnOff(inKey, 0);
+}
+
+void onLongCtrlChanged(byte inCtrl, byte inValue){
+	Serial.print("Longboard pedal ");
+	Serial.print(inCtrl);
+	Serial.print(": ");
+	Serial.println(inValue);
+}
+
+void onLongDisconnected(){
+	Serial.println("Longboard disconnected");
+}
+
+void onShortKeyPressed(byte inKey){
+	Serial.print("Shortboard key ");
+	Serial.println(inKey);
+	shortboard.setLedOnOff(inKey, 1);
+}
+
+void onShortKeyReleased(byte inKey, byte inHeld){
+	shortboard.setLedOnOff(inKey, 0);
+}
+
+void onShortCtrlChanged(byte inCtrl, byte inValue){
+	Serial.print("Shortboard pedal ");
+	Serial.print(inCtrl);
+	Serial.print(": ");
+	Serial.println(inValue);
+}
+
+void onShortDisconnected(){
+	Serial.println("Shortboard disconnected");
+}
+
+void setup() {
+	Serial.begin(115200);
+
+	longboard.begin(&Serial1);
+	longboard.setHandleKeyPressed(&onLongKeyPressed);
+	longboard.setHandleKeyReleased(&onLongKeyReleased);
+	longboard.setHandleCtrlChanged(&onLongCtrlChanged);
+	longboard.setHandleDisconnected(&onLongDisconnected);
+	longboard.setDisplayTitle(longTitle);
+
+	shortboard.begin(&Serial2);
+	shortboard.setHandleKeyPressed(&onShortKeyPressed);
+	shortboard.setHandleKeyReleased(&onShortKeyReleased);
+	shortboard.setHandleCtrlChanged(&onShortCtrlChanged);
+	shortboard.setHandleDisconnected(&onShortDisconnected);
+	shortboard.setDisplayTitle(shortTitle);
+}
+
+void loop() {
+	longboard.read();
+	shortboard.read();
+	longboard.updateUI();
+	shortboard.updateUI();
+}
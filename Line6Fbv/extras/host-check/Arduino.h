@@ -0,0 +1,45 @@
+// Arduino.h for the host check: only what Line6Fbv.h and Line6FbvPedalFilter.h use,
+// millis() and micros() follow hostMillis, which each check sets
+#ifndef LINE6FBV_HOST_ARDUINO_H
+#define LINE6FBV_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+extern unsigned long hostMillis;
+
+inline unsigned long millis(){
+	return hostMillis;
+}
+
+inline unsigned long micros(){
+	return hostMillis * 1000UL;
+}
+
+// the default transport needs the type, a check never opens one
+class HardwareSerial {
+public:
+	void begin(unsigned long){
+	}
+	int available(){
+		return 0;
+	}
+	int read(){
+		return -1;
+	}
+	size_t write(byte){
+		return 1;
+	}
+	size_t write(const byte*, size_t inLength){
+		return inLength;
+	}
+	int availableForWrite(){
+		return 63;
+	}
+};
+
+#endif
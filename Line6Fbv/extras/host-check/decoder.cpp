@@ -0,0 +1,67 @@
+// recorded input with garbage, unknown and broken frames through the ring buffer:
+// the good frames must arrive and the drop counters must see the rest
+#include <stdio.h>
+#include "Line6Fbv.h"
+
+unsigned long hostMillis = 0;
+
+Line6Fbv<Line6FbvRingBuffer> fbv;
+
+byte pressedKey = LINE6FBV_KEY_NONE;
+byte pedalValue = LINE6FBV_PEDAL_UNKNOWN;
+int heartbeats = 0;
+int failed = 0;
+
+void onKeyPressed(byte inKey){
+	pressedKey = inKey;
+}
+
+void onCtrlChanged(byte inPedal, byte inValue){
+	if (inPedal == LINE6FBV_CC_PDL1)
+		pedalValue = inValue;
+}
+
+void onHeartbeat(){
+	heartbeats++;
+}
+
+void expect(const char* inWhat, unsigned long inValue, unsigned long inExpected){
+	if (inValue == inExpected)
+		return;
+	printf("decoder: %s is %lu, expected %lu\n", inWhat, inValue, inExpected);
+	failed++;
+}
+
+int main(){
+	const byte input[] = {
+		0x12, 0x34,                                 // garbage: resync
+		0xF0, 0x03, 0x81, LINE6FBV_CC_STOMP1, 0x01, // key press
+		0xF0, 0x05, 0x40, 0x01, 0x02, 0x03, 0x04,   // unknown, skipped by its length
+		0xF0, 0x03, 0x82, 0x00,                     // cut off by the next F0: malformed
+		0xF0, 0x03, 0x82, 0x00, 0x40,               // pedal 1
+		0xF0, 0x00,                                 // length 0: malformed
+		0x55,                                       // resync
+		0xF0, 0x02, 0x81, 0x12,                     // known opcode, wrong length: malformed
+		0xF0, 0x02, 0x90, 0x00,                     // heartbeat, first frame
+		0xF0, 0x02, 0x30, 0x08                      // heartbeat, second frame
+	};
+
+	fbv.begin();
+	fbv.setHandleKeyPressed(&onKeyPressed);
+	fbv.setHandleCtrlChanged(&onCtrlChanged);
+	fbv.setHandleHeartbeat(&onHeartbeat);
+	for (byte i = 0; i < sizeof(input); i++)
+		fbv.getTransport().putRx(input[i]);
+	hostMillis = 1;
+	fbv.read();
+
+	expect("pressed key", pressedKey, LINE6FBV_STOMP1);
+	expect("pedal value", pedalValue, 0x40);
+	expect("heartbeats", heartbeats, 1);
+	expect("malformed frames", fbv.getRxMalformed(), 3);
+	expect("unknown frames", fbv.getRxUnknown(), 1);
+	expect("resyncs", fbv.getRxResyncs(), 2);
+	if (!failed)
+		printf("decoder: ok\n");
+	return failed ? 1 : 0;
+}
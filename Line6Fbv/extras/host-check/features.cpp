@@ -0,0 +1,65 @@
+// all members of Line6Fbv for one LINE6FBV_FEATURES value, with the default and the ring
+// buffer transport, then the first frames of a board: a board type request must be sent,
+// getNextWakeup() must wait while nothing is to do and return millis() for a new LED,
+// requests without updateUI() in between are counted once the output buffer is full
+#include <stdio.h>
+#include "Line6Fbv.h"
+
+unsigned long hostMillis = 0;
+
+template class Line6Fbv<>;
+template class Line6Fbv<Line6FbvRingBuffer, Line6FbvShortboard>;
+template class Line6Fbv<Line6FbvRingBuffer, Line6FbvExpress>;
+
+Line6Fbv<Line6FbvRingBuffer> fbv;
+
+int main(){
+	const byte board[] = { 0xF0, 0x02, 0x90, 0x00 };   // the first heartbeat frame connects the board
+	fbv.begin();
+	fbv.setLedOnOff(LINE6FBV_TAP, 1);
+	fbv.setDisplayTitle((char*)"HOST CHECK");
+	for (byte i = 0; i < sizeof(board); i++)
+		fbv.getTransport().putRx(board[i]);
+
+	// the board takes every frame, the first ones are kept
+	Line6FbvRingBuffer& port = fbv.getTransport();
+	byte written[4];
+	byte writtenLength = 0;
+	for (hostMillis = 1; hostMillis < 100; hostMillis++){
+		fbv.read();
+		fbv.updateUI();
+		while (port.availableTx()){
+			byte b = port.takeTx();
+			if (writtenLength < sizeof(written))
+				written[writtenLength++] = b;
+		}
+	}
+
+	const byte request[] = { 0xF0, 0x02, 0x01, 0x00 };
+	if (writtenLength < sizeof(request) || memcmp(written, request, sizeof(request))){
+		printf("features 0x%02X: no board type request\n", LINE6FBV_FEATURES);
+		return 1;
+	}
+	if (fbv.getBoardInfo().leds != Line6FbvLongboard::ledMask()){
+		printf("features 0x%02X: LEDs not from the profile\n", LINE6FBV_FEATURES);
+		return 1;
+	}
+	if ((long)(fbv.getNextWakeup() - hostMillis) <= 0){
+		printf("features 0x%02X: no rest while idle\n", LINE6FBV_FEATURES);
+		return 1;
+	}
+	fbv.setLedOnOff(LINE6FBV_STOMP1, 1);
+	if (fbv.getNextWakeup() != hostMillis){
+		printf("features 0x%02X: a new LED waits for getNextWakeup()\n", LINE6FBV_FEATURES);
+		return 1;
+	}
+	unsigned int requests = 0;
+	while (fbv.requestPedalPos())
+		requests++;
+	if (fbv.getTxDropped() != 1 || requests > LINE6FBV_TX_BUFFER_SIZE / 4){
+		printf("features 0x%02X: a dropped request is not counted\n", LINE6FBV_FEATURES);
+		return 1;
+	}
+	printf("features 0x%02X: ok, %u bytes per object\n", LINE6FBV_FEATURES, (unsigned)sizeof(fbv));
+	return 0;
+}
@@ -0,0 +1,95 @@
+// a pedal sweep, jitter at rest and a small move with an overshoot through the filter,
+// then the last small moves the dead-band and the hysteresis hold back must arrive
+// once the pedal rests
+#include <stdio.h>
+#include "Line6FbvPedalFilter.h"
+
+unsigned long hostMillis = 0;
+
+Line6FbvPedalFilter filter;
+int sent = 0;
+int failed = 0;
+
+void report(byte inValue){
+	if (filter.filter(inValue))
+		sent++;
+	if (filter.update())
+		sent++;
+}
+
+void settle(int inMillis){
+	for (int i = 0; i < inMillis; i++){
+		hostMillis++;
+		if (filter.update())
+			sent++;
+	}
+}
+
+void expect(bool inOk, const char* inWhat){
+	if (inOk)
+		return;
+	printf("pedal filter: %s\n", inWhat);
+	failed++;
+}
+
+int main(){
+	// 0 to 127 in 500 ms, one report every 4 ms
+	hostMillis = 1000;
+	for (int v = 0; v <= 127; v++){
+		hostMillis = 1000 + v * 4;
+		report(v);
+	}
+	settle(100);
+	expect(filter.getValue() == 127, "the sweep doesn't end at 127");
+	expect(sent <= 30, "the sweep is not limited by LINE6FBV_PEDAL_MAX_RATE");
+	printf("pedal filter: sweep of 128 positions, %d sent\n", sent);
+
+	// jitter by one step at rest
+	filter.reset(64);
+	hostMillis += 1000;
+	sent = 0;
+	for (int i = 0; i < 200; i++){
+		hostMillis += 30;
+		report(i & 1 ? 65 : 64);
+	}
+	expect(sent == 0, "jitter at rest is sent");
+
+	// move to 70 and back by one step
+	sent = 0;
+	for (int v = 65; v <= 70; v++){
+		hostMillis += 30;
+		report(v);
+	}
+	hostMillis += 30;
+	report(69);
+	settle(50);
+	expect(filter.getValue() == 70, "the overshoot of one step is sent while moving");
+	settle(LINE6FBV_PEDAL_SETTLE_TIME);
+	expect(filter.getValue() == 69, "the position after the overshoot doesn't arrive");
+
+	// a last step of one after a rest
+	filter.reset(64);
+	hostMillis += 1000;
+	report(65);
+	expect(filter.getValue() == 64, "one step at rest passes the dead-band");
+	settle(LINE6FBV_PEDAL_SETTLE_TIME);
+	expect(filter.getValue() == 65, "a last step of one after a rest doesn't arrive");
+
+	// up to 70 and back to 68, a reversal within the hysteresis
+	for (int v = 66; v <= 70; v++){
+		hostMillis += 30;
+		report(v);
+	}
+	settle(50);
+	hostMillis += 30;
+	report(69);
+	hostMillis += 30;
+	report(68);
+	settle(LINE6FBV_PEDAL_SETTLE_TIME);
+	expect(filter.getValue() == 68, "a reversal of two steps doesn't arrive");
+
+	if (!failed)
+		printf("pedal filter: ok, %lu of %lu positions saved\n",
+			filter.getReceived() - filter.getSent(), filter.getReceived());
+	return failed ? 1 : 0;
+}
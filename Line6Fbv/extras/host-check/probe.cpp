@@ -0,0 +1,101 @@
+// liveness probing against a simulated board that answers requestPedalPos():
+// one lost answer is no disconnect, a board that is gone is noticed after
+// LINE6FBV_PROBE_MISSES probes, and a lost board is probed until it is back
+#include <stdio.h>
+#include "Line6Fbv.h"
+
+unsigned long hostMillis = 0;
+
+Line6Fbv<Line6FbvRingBuffer> fbv;
+
+bool boardOn = true;
+int dropAnswers = 0;    // answers the board loses
+int probes = 0;
+int disconnects = 0;
+unsigned long disconnectedAt = 0;
+int failed = 0;
+
+void onDisconnected(){
+	disconnects++;
+	disconnectedAt = hostMillis;
+}
+
+// the board: 10 ms after a pedal request both positions come back
+unsigned long answerAt = 0;
+
+void runBoard(){
+	Line6FbvRingBuffer& port = fbv.getTransport();
+	while (port.availableTx() >= 2){
+		byte frame[32];
+		frame[0] = port.takeTx();
+		frame[1] = port.takeTx();
+		for (byte i = 0; i < frame[1]; i++)
+			frame[2 + i] = port.takeTx();
+		if (frame[1] == 0x02 && frame[2] == 0x01 && frame[3] == 0x01){
+			probes++;
+			if (!boardOn)
+				continue;
+			if (dropAnswers){
+				dropAnswers--;
+				continue;
+			}
+			answerAt = hostMillis + 10;
+		}
+	}
+	if (answerAt && hostMillis >= answerAt){
+		const byte pedals[] = { 0xF0, 0x03, 0x82, 0x00, 0x40, 0xF0, 0x03, 0x82, 0x01, 0x20 };
+		for (byte i = 0; i < sizeof(pedals); i++)
+			port.putRx(pedals[i]);
+		answerAt = 0;
+	}
+}
+
+void run(unsigned long inUntil){
+	for (; hostMillis < inUntil; hostMillis++){
+		fbv.read();
+		fbv.updateUI();
+		runBoard();
+	}
+}
+
+void expect(bool inOk, const char* inWhat){
+	if (inOk)
+		return;
+	printf("probe: %s\n", inWhat);
+	failed++;
+}
+
+int main(){
+	fbv.begin();
+	fbv.setHandleDisconnected(&onDisconnected);
+	fbv.setLivenessProbe(200, 150);
+	const byte heartbeat[] = { 0xF0, 0x02, 0x90, 0x00, 0xF0, 0x02, 0x30, 0x08 };
+	for (byte i = 0; i < sizeof(heartbeat); i++)
+		fbv.getTransport().putRx(heartbeat[i]);
+
+	hostMillis = 1;
+	run(3000);
+	expect(fbv.isConnected() && !disconnects, "the answering board is lost");
+	int healthy = probes;
+
+	dropAnswers = 1;
+	run(5000);
+	expect(fbv.isConnected() && !disconnects, "one lost answer is a disconnect");
+
+	boardOn = false;
+	unsigned long off = hostMillis;
+	run(7000);
+	expect(disconnects == 1, "the board that is gone is not noticed");
+	expect(disconnectedAt - off < 3000, "the board that is gone is noticed late");
+	int offline = probes;
+	run(9000);
+	expect(probes > offline, "the lost board is not probed");
+
+	boardOn = true;
+	run(10000);
+	expect(fbv.isConnected(), "the board is not back before its next heartbeat");
+
+	if (!failed)
+		printf("probe: ok, %d probes in 3 s, disconnect after %lu ms\n", healthy, disconnectedAt - off);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+// LEDs switched on before the board answered, like in setup() of a sketch, must be
+// sent again when the board connects, and the resync must send every LED once
+#include <stdio.h>
+#include "Line6Fbv.h"
+
+unsigned long hostMillis = 0;
+
+Line6Fbv<Line6FbvRingBuffer> fbv;
+
+// frames written since the last call, LED frames F0 03 04 <code> <on> are kept per code
+byte ledState[128];
+int ledFrames[128];
+
+void takeFrames(){
+	Line6FbvRingBuffer& port = fbv.getTransport();
+	byte frame[32];
+	while (port.availableTx() >= 2){
+		frame[0] = port.takeTx();
+		frame[1] = port.takeTx();
+		for (byte i = 0; i < frame[1]; i++)
+			frame[2 + i] = port.takeTx();
+		if (frame[1] == 0x03 && frame[2] == 0x04){
+			ledState[frame[3] & 0x7F] = frame[4];
+			ledFrames[frame[3] & 0x7F]++;
+		}
+	}
+}
+
+int main(){
+	fbv.begin();
+	fbv.setLedOnOff(LINE6FBV_TAP, 1);
+	fbv.setLeds(LINE6FBV_LED(LINE6FBV_DISPLAY), LINE6FBV_LED(LINE6FBV_DISPLAY));
+	for (hostMillis = 1; hostMillis < 10; hostMillis++){
+		fbv.read();
+		fbv.updateUI();
+	}
+	takeFrames();   // the board is not there yet, these go nowhere
+	memset(ledFrames, 0, sizeof(ledFrames));
+
+	const byte heartbeat[] = { 0xF0, 0x02, 0x90, 0x00, 0xF0, 0x02, 0x30, 0x08 };
+	for (byte i = 0; i < sizeof(heartbeat); i++)
+		fbv.getTransport().putRx(heartbeat[i]);
+	for (; hostMillis < 100; hostMillis++){
+		fbv.read();
+		fbv.updateUI();
+		takeFrames();
+	}
+
+	int failed = 0;
+	if (!ledFrames[LINE6FBV_CC_TAP] || !ledState[LINE6FBV_CC_TAP]){
+		printf("resync: TAP not sent on connect\n");
+		failed++;
+	}
+	if (!ledFrames[LINE6FBV_CC_DISPLAY] || !ledState[LINE6FBV_CC_DISPLAY]){
+		printf("resync: DISPLAY not sent on connect\n");
+		failed++;
+	}
+	for (uint8_t key = 1; key < LINE6FBV_NUM_LED_AND_SWITCH; key++){
+		if (!(Line6FbvLongboard::ledMask() & (1UL << key)))
+			continue;
+		if (ledFrames[line6FbvKeyCodes[key] & 0x7F] != 1){
+			printf("resync: LED %d sent %d times\n", key, ledFrames[line6FbvKeyCodes[key] & 0x7F]);
+			failed++;
+		}
+	}
+	if (!fbv.getResyncTime()){
+		printf("resync: not finished\n");
+		failed++;
+	}
+	if (!failed)
+		printf("resync: ok, all LEDs sent in %lu ms\n", fbv.getResyncTime());
+	return failed ? 1 : 0;
+}
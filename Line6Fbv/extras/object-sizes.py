@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+# SRAM of one Line6Fbv object on the AVR for each profile and feature set,
+# without an AVR toolchain: libclang lays the class out for the avr target
+# needs: pip install libclang
+# usage: extras/object-sizes.py [mcu], default atmega2560
+
+import os
+import sys
+import clang.cindex
+
+MCU = sys.argv[1] if len(sys.argv) > 1 else "atmega2560"
+LIBRARY = os.path.abspath(os.path.join(os.path.dirname(__file__), ".."))
+
+# name and LINE6FBV_FEATURES of each configuration, as in size-report.sh
+CONFIGS = [
+	("all", "0x3F"),
+	("no-gestures (KPA)", "0x37"),
+	("no-gestures-hold", "0x33"),
+	("no-marquee-overlays", "0x0F"),
+	("leds-only", "0x01"),
+	("minimal", "0x00"),
+]
+PROFILES = ["Line6FbvLongboard", "Line6FbvShortboard", "Line6FbvExpress"]
+
+# only what Line6Fbv.h needs from the core and avr-libc to be laid out, 16 bit int
+STUBS = {
+	"stub/Arduino.h": """
+typedef unsigned char uint8_t;
+typedef signed char int8_t;
+typedef unsigned int uint16_t;
+typedef int int16_t;
+typedef unsigned long uint32_t;
+typedef long int32_t;
+typedef unsigned int size_t;
+typedef uint8_t byte;
+void* memcpy(void*, const void*, size_t);
+void* memmove(void*, const void*, size_t);
+void* memset(void*, int, size_t);
+int memcmp(const void*, const void*, size_t);
+char* strncpy(char*, const char*, size_t);
+unsigned long millis();
+unsigned long micros();
+class HardwareSerial {
+public:
+	void begin(unsigned long);
+	int available();
+	int read();
+	size_t write(uint8_t);
+	size_t write(const uint8_t*, size_t);
+	int availableForWrite();
+};
+#define SREG (*(volatile uint8_t*)0x5F)
+void cli();
+#define F_CPU 16000000UL
+""",
+	"stub/avr/pgmspace.h": """
+#define PROGMEM __attribute__((progmem))
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+""",
+}
+
+def sizes(features):
+	source = '#include "Line6Fbv.h"\n'
+	for profile in PROFILES:
+		source += "extern char object_%s[sizeof(Line6Fbv<Line6FbvHardwareSerial, %s>)];\n" % (profile, profile)
+	unsaved = [(os.path.join(LIBRARY, "x", name), text) for name, text in STUBS.items()]
+	unsaved.append(("object-sizes.cpp", source))
+	args = ["-x", "c++", "-std=gnu++11", "-target", "avr", "-mmcu=" + MCU, "-nostdinc",
+		"-I" + os.path.join(LIBRARY, "x", "stub"), "-I" + LIBRARY,
+		"-DLINE6FBV_FEATURES=" + features]
+	unit = clang.cindex.Index.create().parse("object-sizes.cpp", args=args, unsaved_files=unsaved)
+	errors = [d for d in unit.diagnostics if d.severity >= clang.cindex.Diagnostic.Error]
+	if errors:
+		for d in errors:
+			print(d)
+		sys.exit(1)
+	result = {}
+	for cursor in unit.cursor.get_children():
+		if cursor.spelling.startswith("object_"):
+			result[cursor.spelling[len("object_"):]] = cursor.type.get_size()
+	return result
+
+print("%-24s %10s %11s %8s" % ("features", "Longboard", "Shortboard", "Express"))
+for name, features in CONFIGS:
+	s = sizes(features)
+	print("%-24s %10d %11d %8d" % ("%s (%s)" % (name, features),
+		s["Line6FbvLongboard"], s["Line6FbvShortboard"], s["Line6FbvExpress"]))
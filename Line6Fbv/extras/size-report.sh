@@ -0,0 +1,30 @@
+#!/bin/sh
+# flash and SRAM of the Line6FbvBenchmark example for each feature set
+# needs arduino-cli with the arduino:avr core
+# usage: extras/size-report.sh [fqbn], default arduino:avr:mega
+
+FQBN=${1:-arduino:avr:mega}
+LIBRARY=$(cd "$(dirname "$0")/.." && pwd)
+SKETCH="$LIBRARY/examples/Line6FbvBenchmark"
+
+# name and LINE6FBV_FEATURES of each configuration
+CONFIGS="
+all:0x3F
+no-gestures:0x37
+no-gestures-hold:0x33
+no-marquee-overlays:0x0F
+leds-only:0x01
+minimal:0x00
+"
+
+printf "%-22s %8s %8s\n" "features" "flash" "sram"
+for CONFIG in $CONFIGS; do
+	NAME=${CONFIG%%:*}
+	FEATURES=${CONFIG#*:}
+	OUTPUT=$(arduino-cli compile --fqbn "$FQBN" --library "$LIBRARY" \
+		--build-property "compiler.cpp.extra_flags=-DLINE6FBV_FEATURES=$FEATURES" \
+		"$SKETCH" 2>&1) || { echo "$NAME: compile failed"; echo "$OUTPUT"; exit 1; }
+	FLASH=$(echo "$OUTPUT" | sed -n 's/^Sketch uses \([0-9]*\) bytes.*/\1/p')
+	SRAM=$(echo "$OUTPUT" | sed -n 's/^Global variables use \([0-9]*\) bytes.*/\1/p')
+	printf "%-22s %8s %8s\n" "$NAME ($FEATURES)" "$FLASH" "$SRAM"
+done
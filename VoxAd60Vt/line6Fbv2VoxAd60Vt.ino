@@ -42,6 +42,7 @@ this should be optimized
 
 */
 #include "Line6Fbv.h"
+#include "Line6FbvPedalFilter.h"
 #include "VoxAd60Vt.h"
 
 Line6Fbv mFbv = Line6Fbv();
@@ -57,6 +58,10 @@ byte mActStatusRev;
 byte mActValWah;
 byte mActValVol;  // sent with every program change
 
+// dead-band, hysteresis and rate of the wah and volume CCs
+Line6FbvPedalFilter mWahFilter;
+Line6FbvPedalFilter mVolFilter;
+
 // Program handling
 byte mActBank;
 byte mNextBank;   // for UP/DOWN events
@@ -319,8 +324,6 @@ void onFbvKeyReleased(byte inKey, byte inKeyHeld) {
 }
 
 void onFbvCtlChanged(byte inCtrl, byte inValue) {
-	Serial.print("FBV CtlChanged ");
-	Serial.println(inValue, HEX);
 	if (inCtrl == LINE6FBV_PDL1){
 		mWahLastMove = millis();
 		if (!mActStatusPdl && mWahAutoOnOff){
@@ -330,18 +333,33 @@ void onFbvCtlChanged(byte inCtrl, byte inValue) {
 			fSetStompLeds();
 
 		}
-		mVox.sendCtlChange(VOXAD60VT_WAH, inValue);
+		if (mWahFilter.filter(inValue))
+			mVox.sendCtlChange(VOXAD60VT_WAH, mWahFilter.getValue());
 	}
 	else{
 		mActValVol = inValue;
-		mVox.sendCtlChange(VOXAD60VT_VOL, inValue);
+		if (mVolFilter.filter(inValue))
+			mVox.sendCtlChange(VOXAD60VT_VOL, mVolFilter.getValue());
 	}
 
 }
 
+// pedal values the filters held back
+void fUpdatePedals(){
+	if (mWahFilter.update())
+		mVox.sendCtlChange(VOXAD60VT_WAH, mWahFilter.getValue());
+	if (mVolFilter.update())
+		mVox.sendCtlChange(VOXAD60VT_VOL, mVolFilter.getValue());
+}
+
 void onFbvHeartbeat() {
 	mFbv.setLedOnOff(LINE6FBV_DISPLAY, 0x01);
 	Serial.println("FBV: Heartbeat");
+	// pedal messages reported by the FBV / sent to the VOX
+	Serial.print("Pedal CCs ");
+	Serial.print(mWahFilter.getReceived() + mVolFilter.getReceived());
+	Serial.print(" / ");
+	Serial.println(mWahFilter.getSent() + mVolFilter.getSent());
 	mVox.sendCtlChange(VOXAD60VT_WAH, mActValWah);
 
 }
@@ -597,6 +615,8 @@ void loop() {
 
 	mVox.read(); // Receive Commands from VOX
 
+	fUpdatePedals(); // send pedal values held back by the filters
+
 	fWahAutoOff(); // switch auto-wah off if time expired
 
 	fDeactivateTapMode(); // leave tap mode if time expired